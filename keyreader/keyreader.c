@@ -28,13 +28,17 @@ size_t dma_size = 0x100000;
 void handle_keypress(void) {
     printf("Reading input from the USB keyboard:\n");
 
+    char keys[32];
+
     while(true) {
-        while (uboot_stdin_tstc() > 0) {
-            char c = uboot_stdin_getc();
-            printf("Received character: %c\n", c, stdout);
-            microkit_ppcall(5, seL4_MessageInfo_new((uint64_t) c,1,0,0));
-            udelay(10000);
+        int count = uboot_input_read(keys, sizeof(keys));
+        for (int i = 0; i < count; i++) {
+            printf("Received character: %c\n", keys[i]);
+            microkit_ppcall(5, seL4_MessageInfo_new((uint64_t) keys[i],1,0,0));
         }
+        /* Idle between polls when no input is pending */
+        if (count <= 0)
+            udelay(10000);
     }
 }
 
@@ -49,6 +49,22 @@ void microkit_dma_free(
     void *ptr,
     size_t size);
 
+/* Placement policies for the DMA allocator. First fit takes the first region
+ * in the free list that can satisfy a request and is the default. Best fit
+ * takes the smallest region that can satisfy a request, trading a full scan
+ * of the free list for less fragmentation of large regions.
+ */
+typedef enum {
+    MICROKIT_DMA_FIRST_FIT,
+    MICROKIT_DMA_BEST_FIT,
+} microkit_dma_policy_t;
+
+/* Select the placement policy used by subsequent calls to microkit_dma_alloc.
+ * This may be changed at any time; existing allocations are unaffected.
+ */
+void microkit_dma_set_policy(
+    microkit_dma_policy_t policy);
+
 /* Return the physical address of a pointer into a DMA buffer. Returns NULL if
  * you pass a pointer into memory that is not part of a DMA buffer. Behaviour
  * is undefined if you pass a pointer into memory that is part of a DMA buffer,
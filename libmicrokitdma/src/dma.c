@@ -24,6 +24,15 @@
 /* Check consistency of bookkeeping structures */
 #define DEBUG_DMA
 
+/* Define MICROKIT_DMA_TRACE to log every allocation and free in the format
+ * consumed by the host replay tool (see tools/dma_replay).
+ */
+#ifdef MICROKIT_DMA_TRACE
+#define TRACE(...) printf("dma-trace: " __VA_ARGS__)
+#else
+#define TRACE(...) do { } while (0)
+#endif
+
 extern uintptr_t dma_base;
 extern uintptr_t dma_cp_paddr;
 
@@ -37,6 +46,9 @@ extern uintptr_t dma_cp_paddr;
  */
 static void *head;
 
+/* The placement policy used when searching the free list. */
+static microkit_dma_policy_t policy = MICROKIT_DMA_FIRST_FIT;
+
 /* This is a helper function to query the name of the current instance */
 extern const char *get_instance_name(void);
 
@@ -486,8 +498,8 @@ int microkit_dma_init(
 uintptr_t microkit_dma_get_paddr(
     void *ptr)
 {
-    int offset = (uint64_t)ptr - (int)dma_base;
-    return (uintptr_t*)(dma_cp_paddr+offset);
+    uintptr_t offset = (uintptr_t)ptr - dma_base;
+    return dma_cp_paddr + offset;
 }
 
 /* Allocate a DMA region from a free region. */
@@ -578,12 +590,51 @@ static void *try_alloc_from_free_region(
     return NULL;
 }
 
+/* Allocate a DMA region from the smallest block in the list of free regions
+ * that is large enough. Returns NULL if that block cannot satisfy the
+ * alignment constraint, in which case the caller falls back to first fit.
+ */
+static void *try_alloc_best_fit(
+    size_t size,
+    unsigned int align,
+    bool cached)
+{
+    region_t *best_prev = NULL, *best = NULL;
+
+    for (region_t *prev = NULL, *p = head; p != NULL; prev = p, p = p->next) {
+        if ((p->size < size) || (p->cached != cached)) {
+            continue;
+        }
+        if (best == NULL || p->size < best->size) {
+            best_prev = prev;
+            best = p;
+            if (best->size == size) {
+                /* Can't do better than an exact fit. */
+                break;
+            }
+        }
+    }
+
+    if (best == NULL) {
+        return NULL;
+    }
+
+    return try_alloc_from_free_region(size, align, best_prev, best);
+}
+
 /* Allocate a DMA region from a block in the list of free regions */
 static void *try_alloc_from_free_list(
     size_t size,
     unsigned int align,
     bool cached)
 {
+    if (policy == MICROKIT_DMA_BEST_FIT) {
+        void *q = try_alloc_best_fit(size, align, cached);
+        if (NULL != q) {
+            return q;
+        }
+    }
+
     /* For each region in the free list... */
     for (region_t *prev = NULL, *p = head; p != NULL; prev = p, p = p->next) {
 
@@ -608,6 +659,10 @@ void *microkit_dma_alloc(
     unsigned int align,
     bool cached)
 {
+#ifdef MICROKIT_DMA_TRACE
+    size_t requested_size = size;
+    unsigned int requested_align = align;
+#endif
 
     STATS(({
         stats.total_allocations++;
@@ -635,6 +690,7 @@ void *microkit_dma_alloc(
         UBOOT_LOGE("DMA pool empty, can't alloc block of size %zu (align=%u, cached=%u)",
                 size, align, cached);
         STATS(stats.failed_allocations_out_of_memory++);
+        TRACE("alloc 0x0 %zu %u %u\n", requested_size, requested_align, cached);
         return NULL;
     }
 
@@ -683,6 +739,8 @@ void *microkit_dma_alloc(
 
     check_consistency();
 
+    TRACE("alloc 0x%lx %zu %u %u\n", (uintptr_t)p, requested_size, requested_align, cached);
+
     if (p == NULL) {
         STATS(stats.failed_allocations_other++);
     } else {
@@ -698,6 +756,12 @@ void *microkit_dma_alloc(
     return p;
 }
 
+void microkit_dma_set_policy(
+    microkit_dma_policy_t new_policy)
+{
+    policy = new_policy;
+}
+
 void microkit_dma_free(
     void *ptr,
     size_t size)
@@ -705,6 +769,8 @@ void microkit_dma_free(
     // Cached is set to true in the system file 
     bool cached = 1;
 
+    TRACE("free 0x%lx %zu\n", (uintptr_t)ptr, size);
+
     /* Call the common function to free the DMA memory */
     free_region(ptr, size, cached);
 }
@@ -0,0 +1,446 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host replay tool for DMA allocation traces.
+ *
+ * Replays a trace of microkit_dma_alloc / microkit_dma_free calls against a
+ * natively compiled copy of the DMA allocator, once for every combination of
+ * placement policy and pool size requested, and reports peak usage, the
+ * points at which allocations failed and the latency distribution of each
+ * operation. This allows the 'dma_size' of a protection domain to be chosen,
+ * and changes to the allocator to be evaluated, against real workloads.
+ *
+ * The trace is a text file with one operation per line:
+ *
+ *   alloc <id> <size> <align> <cached>
+ *   free <id> [<size>]
+ *
+ * where <id> identifies the allocation (e.g. the returned virtual address),
+ * with an id of 0 recording a request that failed when the trace was taken.
+ * Numbers may be given in decimal or hex (0x prefix). Lines may be prefixed
+ * with "dma-trace: " as emitted by the allocator when built with
+ * MICROKIT_DMA_TRACE defined, all other lines are ignored, so a console log
+ * captured from a board can be replayed directly.
+ *
+ * Usage: dma_replay [-p pool_size]... [-P policy]... [-g page_size] [-v] trace
+ *
+ *   -p  Pool size in bytes to replay against (may be repeated, default 1 MiB)
+ *   -P  Placement policy, 'first-fit' or 'best-fit' (may be repeated,
+ *       default both)
+ *   -g  Page size the pool is split into at initialisation (default 4096)
+ *   -v  Report every allocation failure rather than the first few
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <dma_microkit.h>
+
+#define MAX_CONFIGS         16
+#define REPORTED_FAILURES   8
+#define LATENCY_BUCKETS     32
+#define TRACE_PREFIX        "dma-trace: "
+
+/* The DMA allocator translates virtual to physical addresses relative to
+ * these symbols, which are normally patched in from the system file. */
+uintptr_t dma_base;
+uintptr_t dma_cp_paddr;
+
+int dma_replay_verbose = 0;
+
+typedef enum { OP_ALLOC, OP_FREE } op_type_t;
+
+typedef struct {
+    op_type_t type;
+    /* Dense index of the allocation this operation refers to */
+    size_t slot;
+    size_t size;
+    unsigned int align;
+    bool cached;
+    /* Line of the trace file the operation was read from */
+    unsigned long line;
+} trace_op_t;
+
+typedef struct {
+    trace_op_t *ops;
+    size_t op_count;
+    size_t slot_count;
+} trace_t;
+
+typedef struct {
+    const char *name;
+    microkit_dma_policy_t policy;
+} policy_name_t;
+
+static const policy_name_t policy_names[] = {
+    { "first-fit", MICROKIT_DMA_FIRST_FIT },
+    { "best-fit",  MICROKIT_DMA_BEST_FIT },
+};
+
+typedef struct {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    /* Log2 histogram; bucket n counts latencies in [2^n, 2^(n+1)) ns */
+    uint64_t buckets[LATENCY_BUCKETS];
+} latency_t;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "Usage: %s [-p pool_size]... [-P first-fit|best-fit]... "
+        "[-g page_size] [-v] trace\n", prog);
+    exit(EXIT_FAILURE);
+}
+
+/* Map allocation ids found in the trace onto a dense range of slots. Ids are
+ * only live between an alloc and the matching free, so an id that is reused
+ * after being freed is given a new slot. */
+typedef struct {
+    unsigned long id;
+    size_t slot;
+    bool used;
+} id_entry_t;
+
+static id_entry_t *id_table;
+static size_t id_table_size;
+
+static id_entry_t *id_lookup(unsigned long id)
+{
+    size_t index = (id * 0x9E3779B97F4A7C15ull) % id_table_size;
+    while (id_table[index].used && id_table[index].id != id) {
+        index = (index + 1) % id_table_size;
+    }
+    return &id_table[index];
+}
+
+static int parse_trace(const char *path, trace_t *trace)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Unable to open trace '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    size_t capacity = 1024;
+    trace->ops = malloc(capacity * sizeof(trace_op_t));
+    trace->op_count = 0;
+    trace->slot_count = 0;
+
+    /* Size the id table generously; traces with more live allocations than
+     * half the table can hold are rejected. */
+    id_table_size = 1 << 16;
+    id_table = calloc(id_table_size, sizeof(id_entry_t));
+    size_t live_ids = 0;
+
+    char line[256];
+    unsigned long line_number = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+
+        char *text = strstr(line, TRACE_PREFIX);
+        text = (text != NULL) ? text + strlen(TRACE_PREFIX) : line;
+
+        char op[8];
+        unsigned long id, size = 0, align = 0, cached = 1;
+        int fields = sscanf(text, "%7s %li %li %li %li", op, &id, &size, &align, &cached);
+
+        trace_op_t entry = { .line = line_number };
+        if (fields == 5 && strcmp(op, "alloc") == 0) {
+            entry.type = OP_ALLOC;
+            entry.size = size;
+            entry.align = align;
+            entry.cached = cached != 0;
+
+            if (id == 0) {
+                /* The allocation failed when the trace was captured, so it
+                 * is never freed. Replay the request without tracking it. */
+                entry.slot = trace->slot_count++;
+                goto append;
+            }
+
+            id_entry_t *e = id_lookup(id);
+            if (e->used) {
+                fprintf(stderr, "%s:%lu: id 0x%lx allocated twice without free\n",
+                    path, line_number, id);
+            } else if (2 * (live_ids + 1) > id_table_size) {
+                fprintf(stderr, "%s:%lu: too many live allocations\n", path, line_number);
+                fclose(file);
+                return -1;
+            } else {
+                live_ids++;
+            }
+            e->used = true;
+            e->id = id;
+            e->slot = trace->slot_count++;
+            entry.slot = e->slot;
+        } else if (fields >= 2 && strcmp(op, "free") == 0) {
+            id_entry_t *e = id_lookup(id);
+            if (!e->used) {
+                fprintf(stderr, "%s:%lu: free of unknown id 0x%lx ignored\n",
+                    path, line_number, id);
+                continue;
+            }
+            entry.type = OP_FREE;
+            entry.slot = e->slot;
+            entry.size = (fields >= 3) ? size : 0;
+
+            /* Remove the id using backward-shift deletion so that probe
+             * sequences for other ids remain intact. */
+            size_t hole = e - id_table;
+            id_table[hole].used = false;
+            live_ids--;
+            for (size_t next = (hole + 1) % id_table_size; id_table[next].used;
+                    next = (next + 1) % id_table_size) {
+                id_entry_t moved = id_table[next];
+                id_table[next].used = false;
+                *id_lookup(moved.id) = moved;
+            }
+        } else {
+            /* Not a trace line */
+            continue;
+        }
+
+append:
+        if (trace->op_count == capacity) {
+            capacity *= 2;
+            trace->ops = realloc(trace->ops, capacity * sizeof(trace_op_t));
+        }
+        trace->ops[trace->op_count++] = entry;
+    }
+
+    fclose(file);
+    free(id_table);
+    return 0;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void record_latency(latency_t *latency, uint64_t ns)
+{
+    latency->count++;
+    latency->total_ns += ns;
+    if (ns > latency->max_ns) {
+        latency->max_ns = ns;
+    }
+    int bucket = (ns == 0) ? 0 : 63 - __builtin_clzll(ns);
+    if (bucket >= LATENCY_BUCKETS) {
+        bucket = LATENCY_BUCKETS - 1;
+    }
+    latency->buckets[bucket]++;
+}
+
+/* Return an upper bound on the given percentile from the log2 histogram */
+static uint64_t latency_percentile(const latency_t *latency, unsigned int percent)
+{
+    uint64_t target = (latency->count * percent + 99) / 100;
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < LATENCY_BUCKETS; bucket++) {
+        seen += latency->buckets[bucket];
+        if (seen >= target && seen > 0) {
+            return (2ull << bucket) - 1;
+        }
+    }
+    return latency->max_ns;
+}
+
+static void print_latency(const char *name, const latency_t *latency)
+{
+    if (latency->count == 0) {
+        printf("  %-5s latency: no operations\n", name);
+        return;
+    }
+    printf("  %-5s latency (ns): mean %llu, p50 <%llu, p90 <%llu, p99 <%llu, max %llu\n",
+        name,
+        (unsigned long long)(latency->total_ns / latency->count),
+        (unsigned long long)latency_percentile(latency, 50),
+        (unsigned long long)latency_percentile(latency, 90),
+        (unsigned long long)latency_percentile(latency, 99),
+        (unsigned long long)latency->max_ns);
+}
+
+/* Replay the trace against a freshly initialised allocator. This is run in
+ * a child process so that every configuration starts from a clean allocator
+ * (the allocator keeps its state in statics and has no teardown). */
+static int replay(const trace_t *trace, const policy_name_t *policy,
+    size_t pool_size, size_t page_size)
+{
+    void *pool = aligned_alloc(page_size, pool_size);
+    if (pool == NULL) {
+        fprintf(stderr, "Unable to allocate a pool of %zu bytes\n", pool_size);
+        return -1;
+    }
+
+    /* Use an arbitrary non-zero physical base; the allocator treats a
+     * physical address of zero as unknown. */
+    dma_base = (uintptr_t)pool;
+    dma_cp_paddr = 0x40000000;
+
+    microkit_dma_set_policy(policy->policy);
+    if (microkit_dma_init(pool, pool_size, page_size, true) != 0) {
+        fprintf(stderr, "DMA initialisation failed (pool %zu, page %zu)\n",
+            pool_size, page_size);
+        return -1;
+    }
+
+    void **ptrs = calloc(trace->slot_count, sizeof(void *));
+    size_t *sizes = calloc(trace->slot_count, sizeof(size_t));
+    latency_t alloc_latency = { 0 }, free_latency = { 0 };
+    size_t outstanding = 0, peak_outstanding = 0;
+    uint64_t failures = 0;
+
+    printf("policy %s, pool 0x%zx bytes, page 0x%zx bytes\n",
+        policy->name, pool_size, page_size);
+
+    for (size_t i = 0; i < trace->op_count; i++) {
+        const trace_op_t *op = &trace->ops[i];
+
+        if (op->type == OP_ALLOC) {
+            uint64_t start = now_ns();
+            void *p = microkit_dma_alloc(op->size, op->align, op->cached);
+            record_latency(&alloc_latency, now_ns() - start);
+
+            if (p == NULL) {
+                failures++;
+                if (dma_replay_verbose || failures <= REPORTED_FAILURES) {
+                    printf("  FAILED op %zu (line %lu): alloc 0x%zx align %u "
+                        "with 0x%zx bytes outstanding\n",
+                        i, op->line, op->size, op->align, outstanding);
+                }
+                continue;
+            }
+
+            ptrs[op->slot] = p;
+            sizes[op->slot] = op->size;
+            outstanding += op->size;
+            if (outstanding > peak_outstanding) {
+                peak_outstanding = outstanding;
+            }
+        } else {
+            void *p = ptrs[op->slot];
+            if (p == NULL) {
+                /* The matching allocation failed */
+                continue;
+            }
+            size_t size = op->size ? op->size : sizes[op->slot];
+
+            uint64_t start = now_ns();
+            microkit_dma_free(p, size);
+            record_latency(&free_latency, now_ns() - start);
+
+            ptrs[op->slot] = NULL;
+            outstanding -= sizes[op->slot];
+        }
+    }
+
+    if (failures > REPORTED_FAILURES && !dma_replay_verbose) {
+        printf("  ... %llu further failures not shown (use -v)\n",
+            (unsigned long long)(failures - REPORTED_FAILURES));
+    }
+
+    const microkit_dma_stats_t *stats = microkit_dma_stats();
+    printf("  allocations %llu, failed %llu, succeeded after defrag %llu, "
+        "defragmentations %llu\n",
+        (unsigned long long)stats->total_allocations,
+        (unsigned long long)failures,
+        (unsigned long long)stats->succeeded_allocations_on_defrag,
+        (unsigned long long)stats->defragmentations);
+    printf("  peak requested 0x%zx bytes, peak pool usage 0x%zx bytes (%zu%%)\n",
+        peak_outstanding,
+        stats->heap_size - stats->minimum_heap_size,
+        (stats->heap_size - stats->minimum_heap_size) * 100 / stats->heap_size);
+    print_latency("alloc", &alloc_latency);
+    print_latency("free", &free_latency);
+
+    return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    size_t pool_sizes[MAX_CONFIGS];
+    int pool_count = 0;
+    const policy_name_t *policies[MAX_CONFIGS];
+    int policy_count = 0;
+    size_t page_size = 4096;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:P:g:v")) != -1) {
+        switch (opt) {
+        case 'p':
+            if (pool_count == MAX_CONFIGS)
+                usage(argv[0]);
+            pool_sizes[pool_count++] = strtoul(optarg, NULL, 0);
+            break;
+        case 'P': {
+            const policy_name_t *match = NULL;
+            for (size_t i = 0; i < sizeof(policy_names) / sizeof(policy_names[0]); i++)
+                if (strcmp(optarg, policy_names[i].name) == 0)
+                    match = &policy_names[i];
+            if (match == NULL || policy_count == MAX_CONFIGS)
+                usage(argv[0]);
+            policies[policy_count++] = match;
+            break;
+        }
+        case 'g':
+            page_size = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            dma_replay_verbose = 1;
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1)
+        usage(argv[0]);
+
+    /* Defaults: the 'dma_size' used by the example PDs, under all policies */
+    if (pool_count == 0)
+        pool_sizes[pool_count++] = 0x100000;
+    if (policy_count == 0)
+        for (size_t i = 0; i < sizeof(policy_names) / sizeof(policy_names[0]); i++)
+            policies[policy_count++] = &policy_names[i];
+
+    trace_t trace;
+    if (parse_trace(argv[optind], &trace) != 0)
+        return EXIT_FAILURE;
+    printf("Replaying %zu operations from %s\n\n", trace.op_count, argv[optind]);
+
+    int exit_code = EXIT_SUCCESS;
+    for (int p = 0; p < policy_count; p++) {
+        for (int s = 0; s < pool_count; s++) {
+            fflush(stdout);
+            pid_t child = fork();
+            if (child == 0) {
+                int ret = replay(&trace, policies[p], pool_sizes[s], page_size);
+                fflush(stdout);
+                _exit(ret < 0 ? 2 : ret);
+            }
+
+            int status;
+            if (child < 0 || waitpid(child, &status, 0) < 0 || !WIFEXITED(status)) {
+                printf("  replay did not complete\n");
+                exit_code = EXIT_FAILURE;
+            } else if (WEXITSTATUS(status) != 0) {
+                exit_code = EXIT_FAILURE;
+            }
+            printf("\n");
+        }
+    }
+
+    return exit_code;
+}
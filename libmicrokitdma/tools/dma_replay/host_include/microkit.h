@@ -0,0 +1,12 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host replacement for the Microkit header. The DMA allocator only requires
+ * the header to exist when built natively. */
+
+#pragma once
+
+#include <stdint.h>
@@ -0,0 +1,12 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host replacement for the seL4 header providing the types referenced by
+ * the DMA allocator's public header. */
+
+#pragma once
+
+typedef unsigned long seL4_CPtr;
@@ -0,0 +1,28 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host replacement for the library's logging wrappers. Only errors and
+ * fatal messages are reported; informational messages from the allocator
+ * (e.g. defragmentation retries) would swamp the replay output. */
+
+#pragma once
+
+#include <stdio.h>
+
+#define UBOOT_LOG_PRINTF(...) ({ \
+    fprintf(stderr, "%s: ", __func__); \
+    fprintf(stderr, __VA_ARGS__); \
+    fprintf(stderr, "\n"); \
+})
+
+#define UBOOT_LOGV(...) ({})
+#define UBOOT_LOGD(...) ({})
+#define UBOOT_LOGI(...) ({})
+#define UBOOT_LOGW(...) ({})
+#define UBOOT_LOGE(...) ({ if (dma_replay_verbose) UBOOT_LOG_PRINTF(__VA_ARGS__); })
+#define UBOOT_LOGF(...) UBOOT_LOG_PRINTF(__VA_ARGS__)
+
+extern int dma_replay_verbose;
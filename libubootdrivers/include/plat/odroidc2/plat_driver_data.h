@@ -11,19 +11,12 @@
  *
  * It should be noted that some of these are fundamental to allowing the U-Boot
  * driver model to function (e.g. the nop, root and simple bus drivers).
+ *
+ * At build time scripts/gen_driver_lists.py reads the declarations below to
+ * place each U-Boot linker list (e.g. the list of drivers) in the order
+ * given here, so the order of entries within each list is significant.
  */
 
-/* Define the number of different driver elements to be used on this platform */
-#define _u_boot_uclass_driver_count     9
-#define _u_boot_driver_count            7
-#define _u_boot_usb_driver_entry_count  0
-#define _u_boot_part_driver_count       0
-#define _u_boot_cmd_count               6
-#define _u_boot_env_driver_count        0
-#define _u_boot_env_clbk_count          0
-#define _u_boot_driver_info_count       0
-#define _u_boot_udevice_count           0
-
 /* Define the uclass drivers to be used on this platform */
 extern struct uclass_driver _u_boot_uclass_driver__nop;
 extern struct uclass_driver _u_boot_uclass_driver__root;
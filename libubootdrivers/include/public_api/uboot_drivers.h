@@ -5,12 +5,15 @@
  * 
  */
 
+#include <stdbool.h>
 #include <io_dma.h>
 
 /*
  * initialise_uboot_drivers() - initialise the u-boot driver library.
  *
  * This must be called before any other interface exported by the library.
+ * Calling it again has no effect other than to select the library's default
+ * context (see uboot_ctx_t) for use.
  *
  * @io_ops: the thread's platform support IO operations
  * @reg_paths: list device tree paths with 'reg' entries to memory map
@@ -27,6 +30,118 @@ int initialise_uboot_drivers(
     const char **dev_paths,
     uint32_t dev_count);
 
+/**
+ * A library context. Each context has its own device tree, driver model
+ *   and DMA manager, allowing independent groups of devices to be driven
+ *   from one protection domain. Only one context is in use at a time; the
+ *   library's other routines act on the context last created or selected.
+ *   State held by U-Boot's subsystems outside of its global data is shared
+ *   between contexts and set up by the first context created: the
+ *   environment, the stdio devices and the network stack. The library's
+ *   block cache and file handles are also shared, so contexts must not be
+ *   used concurrently. When the library is built to use a live tree
+ *   generated at build time (UBOOT_LIVE_TREE), only one context may exist.
+ *   initialise_uboot_drivers and shutdown_uboot_drivers manage a default
+ *   context.
+ */
+typedef struct uboot_ctx uboot_ctx_t;
+
+/**
+ * uboot_ctx_create() - create and initialise a library context, and select
+ *   it for use. The devices of different contexts should not overlap. When
+ *   the library uses a live tree generated at build time, @dev_paths must
+ *   match the paths it was generated from.
+ *
+ * @dma_manager: the DMA manager used by the context's drivers
+ * @orig_fdt_blob: the device tree
+ * @dev_paths: list device tree paths of devices to handle
+ * @dev_count: the length of the dev_paths list
+ *
+ * Return: the context, or NULL on failure.
+ */
+uboot_ctx_t *uboot_ctx_create(
+    ps_dma_man_t dma_manager,
+    const char *orig_fdt_blob,
+    const char **dev_paths,
+    uint32_t dev_count);
+
+/**
+ * uboot_ctx_select() - select a context for use by the library's routines.
+ *
+ * @ctx: the context returned by uboot_ctx_create.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_ctx_select(uboot_ctx_t *ctx);
+
+/**
+ * uboot_ctx_destroy() - shutdown a context and release its resources. No
+ *   context is in use afterwards if this was the selected context.
+ *
+ * @ctx: the context returned by uboot_ctx_create.
+ */
+void uboot_ctx_destroy(uboot_ctx_t *ctx);
+
+/**
+ * uboot_init_step() - probe the next device not yet probed. When the library
+ *   is built for lazy probing (LIB_UBOOT_LAZY_PROBE) devices are not probed
+ *   by initialise_uboot_drivers. Calling this routine repeatedly, e.g.
+ *   between handling other events, brings up the MMC and Ethernet devices a
+ *   device at a time so that the protection domain remains responsive. The
+ *   time taken to probe each device, and the time since initialisation at
+ *   which it became ready, is logged.
+ *
+ *   Each call probes a whole device, waiting on any delays within the
+ *   driver's probe (e.g. PHY autonegotiation). The delays of different
+ *   devices are not overlapped, so the total time to bring up all devices
+ *   is not reduced, only split between calls.
+ *
+ * Return: 1 if devices remain to be probed, 0 if all devices have been
+ *   probed, otherwise failure.
+ */
+int uboot_init_step(void);
+
+/**
+ * A phase of the selected context's initialisation, e.g. building the live
+ *   tree or probing a device (named by the device).
+ *
+ * @name: the name of the phase
+ * @start_us: the time (in microseconds) from the start of initialisation at
+ *   which the phase started
+ * @duration_us: the time (in microseconds) taken by the phase
+ */
+struct uboot_init_phase {
+    const char *name;
+    unsigned long start_us;
+    unsigned long duration_us;
+};
+
+/**
+ * uboot_get_init_profile() - get the phases of the selected context's
+ *   initialisation, in the order they started. Devices probed later through
+ *   uboot_init_step, or on first use, and the first 'usb start' command
+ *   are included as phases. No phases are recorded on platforms without a
+ *   timer (e.g. odroidc2).
+ *
+ * @phases: array to fill with the phases
+ * @max: the length of the phases array
+ *
+ * Return: the number of phases, otherwise negative on failure.
+ */
+int uboot_get_init_profile(struct uboot_init_phase *phases, int max);
+
+/**
+ * uboot_print_init_profile() - print the phases of the selected context's
+ *   initialisation, either as a table sorted by the time taken by each
+ *   phase or as base64 encoded CBOR (as written by libutils' cbor64) for
+ *   processing offline.
+ *
+ * @cbor: true to print as CBOR, false to print as a table
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_print_init_profile(bool cbor);
+
 /**
  * run_uboot_command() - executes a u-boot command as if entered at the
  *   u-boot command prompt
@@ -37,6 +152,48 @@ int initialise_uboot_drivers(
  */
 int run_uboot_command(char* cmd);
 
+/**
+ * uboot_dump_command_stats() - print the statistics of the commands run
+ *   through run_uboot_command, by command name: the number of runs and
+ *   failures, the mean and maximum time taken, the bytes transferred by file
+ *   system load and write commands, and a histogram of the time taken with
+ *   a bucket per power of two microseconds. Statistics are only kept when
+ *   the library is built with LIB_UBOOT_COMMAND_STATS set.
+ */
+void uboot_dump_command_stats(void);
+
+/**
+ * uboot_command_prepare() - prepares a u-boot command to be run repeatedly
+ *   through uboot_command_exec. The command table entry is resolved and the
+ *   command split into arguments once, when prepared.
+ *
+ * @fmt: the command, with each argument separated by whitespace. Variable
+ *   arguments are given by an argument consisting of one of the conversions
+ *   %s, %d, %i, %u, %x, %lu, %lx or %p. Quoting, environment variables and
+ *   multiple commands are not supported.
+ *
+ * Return: a non-negative handle if OK, otherwise failure.
+ */
+int uboot_command_prepare(const char *fmt);
+
+/**
+ * uboot_command_exec() - runs a command prepared by uboot_command_prepare.
+ *
+ * @handle: handle returned by uboot_command_prepare.
+ * @...: values for the variable arguments, in order.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_command_exec(int handle, ...);
+
+/**
+ * uboot_command_release() - releases a command prepared by
+ *   uboot_command_prepare.
+ *
+ * @handle: handle returned by uboot_command_prepare.
+ */
+void uboot_command_release(int handle);
+
 /**
  * uboot_monotonic_timer_get_us() - returns the time in microseconds from
  *   the monotonic timer.
@@ -66,6 +223,17 @@ int uboot_stdin_tstc();
  */
 int uboot_stdin_getc();
 
+/**
+ * uboot_input_read() - reads all characters currently available from
+ *   u-boot's stdin, up to a maximum of @max. This routine does not block.
+ *
+ * @events: buffer to receive the characters.
+ * @max: the size of @events.
+ *
+ * Return: negative on error, otherwise the number of characters read.
+ */
+int uboot_input_read(char *events, int max);
+
 /**
  * uboot_eth_init() - Initialise ethernet. Must be called prior to other
  *    u_boot_eth_xxx routines.
@@ -93,6 +261,23 @@ void uboot_eth_halt(void);
  */
 int uboot_eth_send(unsigned char *packet, int length);
 
+/**
+ * uboot_eth_send_batch() - Send several ethernet packets in a single call.
+ *
+ * @packets: array of pointers to the packets to send.
+ * @lengths: array holding the length of each packet.
+ * @count: the number of packets to send.
+ *
+ * Packets are sent in order. Sending stops at the first packet the driver
+ * fails to send. Each packet is passed to the driver's send operation in
+ * turn, which waits for its transmission to complete, so this is no faster
+ * than calling uboot_eth_send() for each packet.
+ *
+ * Return: negative on error if no packets could be sent, otherwise the
+ *    number of packets sent.
+ */
+int uboot_eth_send_batch(unsigned char **packets, int *lengths, int count);
+
 /**
  * uboot_eth_receive() - Receive an ethernet packet.
  *
@@ -118,6 +303,82 @@ int uboot_eth_receive(unsigned char **packet);
  */
 int uboot_eth_free_packet(unsigned char **packet);
 
+/**
+ * uboot_eth_receive_burst() - Receive up to @max ethernet packets in a
+ *    single call.
+ *
+ * @packets: array filled with pointers to the received packets. Each packet
+ *    remains valid until handed back through uboot_eth_release_burst.
+ * @lengths: array filled with the length of each received packet.
+ * @max: the maximum number of packets to receive.
+ *
+ * At most LIB_UBOOT_ETH_RX_BUFFERS (set through CMake) packets may be held
+ * by the caller at once; once all are held no further packets are received
+ * until some are released.
+ *
+ * Return: -EAGAIN if all buffers are held by the caller, otherwise negative
+ *    on error or the number of packets received (0 if none are waiting).
+ */
+int uboot_eth_receive_burst(unsigned char **packets, int *lengths, int max);
+
+/**
+ * uboot_eth_release_burst() - Hand back packets received through
+ *    uboot_eth_receive_burst.
+ *
+ * @packets: array of packet pointers returned by uboot_eth_receive_burst.
+ * @count: the number of packets to release.
+ *
+ * Pointers that are not held packets from uboot_eth_receive_burst are
+ * ignored with a warning.
+ */
+void uboot_eth_release_burst(unsigned char **packets, int count);
+
+/**
+ * typedef uboot_eth_rx_handler_t - handler for packets received through
+ *    interrupt driven reception. The packet is only valid for the duration
+ *    of the call.
+ */
+typedef void (*uboot_eth_rx_handler_t)(unsigned char *packet, int length, void *cookie);
+
+/**
+ * uboot_eth_irq_init() - Enable interrupt driven reception of ethernet
+ *    packets. Must be called after uboot_eth_init.
+ *
+ * @channel: the Microkit channel the ethernet receive interrupt is
+ *    delivered on, as set in the system file.
+ * @handler: called for each packet received.
+ * @cookie: passed to each call of @handler.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_eth_irq_init(int channel, uboot_eth_rx_handler_t handler, void *cookie);
+
+/**
+ * uboot_eth_irq_handler() - Handle a Microkit notification. To be called
+ *    from the protection domain's notified() routine.
+ *
+ * @channel: the channel the notification was received on. Notifications
+ *    on other channels are ignored.
+ *
+ * On an interrupt, receive interrupts are masked and up to a budget of
+ * packets are received. If more packets remain, interrupts stay masked and
+ * the caller must continue to receive them through uboot_eth_poll.
+ *
+ * Return: negative on error, 1 if packets remain to be received through
+ *    uboot_eth_poll, otherwise 0.
+ */
+int uboot_eth_irq_handler(int channel);
+
+/**
+ * uboot_eth_poll() - Continue receiving packets following a call to
+ *    uboot_eth_irq_handler or uboot_eth_poll that returned 1. Receive
+ *    interrupts are re-enabled once no packets remain.
+ *
+ * Return: negative on error, 1 if packets remain to be received through
+ *    uboot_eth_poll, otherwise 0.
+ */
+int uboot_eth_poll(void);
+
 /**
  * uboot_eth_get_ethaddr() - Return the MAC address.
  *
@@ -125,6 +386,256 @@ int uboot_eth_free_packet(unsigned char **packet);
  */
 unsigned char *uboot_eth_get_ethaddr(void);
 
+/**
+ * struct uboot_blk_info - geometry of a block device.
+ *
+ * @block_size: the size of a block in bytes.
+ * @block_count: the number of blocks on the device.
+ */
+struct uboot_blk_info {
+    unsigned long block_size;
+    unsigned long long block_count;
+};
+
+/**
+ * uboot_blk_open() - Open a block device for direct block access. Reads
+ *    and writes through the returned handle bypass the u-boot command line.
+ *
+ * @if_typename: the interface type of the device, e.g. "mmc" or "usb".
+ * @devnum: the device number on that interface.
+ *
+ * Return: a non-negative handle if OK, otherwise failure.
+ */
+int uboot_blk_open(const char *if_typename, int devnum);
+
+/**
+ * uboot_blk_read() - Read blocks from an open block device.
+ *
+ * @handle: handle returned by uboot_blk_open.
+ * @lba: the first block to read.
+ * @count: the number of blocks to read.
+ * @buffer: buffer of at least count * block_size bytes to read into.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_blk_read(int handle, unsigned long lba, unsigned long count, void *buffer);
+
+/**
+ * uboot_blk_write() - Write blocks to an open block device.
+ *
+ * @handle: handle returned by uboot_blk_open.
+ * @lba: the first block to write.
+ * @count: the number of blocks to write.
+ * @buffer: buffer of at least count * block_size bytes to write from.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_blk_write(int handle, unsigned long lba, unsigned long count, const void *buffer);
+
+/**
+ * uboot_blk_info() - Return the geometry of an open block device.
+ *
+ * @handle: handle returned by uboot_blk_open.
+ * @info: populated with the device geometry.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_blk_info(int handle, struct uboot_blk_info *info);
+
+/**
+ * uboot_blk_close() - Close a block device handle.
+ *
+ * @handle: handle returned by uboot_blk_open.
+ */
+void uboot_blk_close(int handle);
+
+/**
+ * struct uboot_blk_request - a block request to be queued against a handle.
+ *
+ * @write: true to write the blocks, false to read them.
+ * @lba: the first block to transfer.
+ * @count: the number of blocks to transfer.
+ * @buffer: buffer of at least count * block_size bytes. This must remain
+ *    valid until the request has completed.
+ * @callback: optional routine called when the request completes, passed the
+ *    cookie and the completion status (0 if OK, otherwise failure).
+ * @cookie: caller supplied value identifying the request on completion.
+ */
+struct uboot_blk_request {
+    bool write;
+    unsigned long lba;
+    unsigned long count;
+    void *buffer;
+    void (*callback)(void *cookie, int status);
+    void *cookie;
+};
+
+/**
+ * struct uboot_blk_completion - the completion of a queued block request.
+ *
+ * @cookie: the cookie supplied with the request.
+ * @status: 0 if the request completed OK, otherwise failure.
+ */
+struct uboot_blk_completion {
+    void *cookie;
+    int status;
+};
+
+/**
+ * uboot_blk_sync() - Write any data held by the block cache for the device
+ *    to the device. When the cache is configured for write-back
+ *    (LIB_UBOOT_BLK_CACHE_WRITE_BACK), writes are only durable once
+ *    followed by a successful sync. Otherwise this has no effect.
+ *
+ * @handle: handle returned by uboot_blk_open.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_blk_sync(int handle);
+
+/**
+ * uboot_blk_submit() - Queue a block request against an open block device.
+ *    The request is not issued until uboot_blk_process is called, allowing
+ *    several requests to be outstanding at once.
+ *
+ * @handle: handle returned by uboot_blk_open.
+ * @request: the request to queue. The request is copied.
+ *
+ * Return: 0 if OK, -EAGAIN if the queue is full, otherwise failure.
+ */
+int uboot_blk_submit(int handle, const struct uboot_blk_request *request);
+
+/**
+ * uboot_blk_process() - Issue all requests queued against a block device.
+ *    Requests are sorted by block address where it is safe to do so, and
+ *    adjacent requests in the same direction are merged into multi-block
+ *    transfers. Each request completes through its callback (if supplied)
+ *    and through the completion queue read by uboot_blk_complete.
+ *
+ * @handle: handle returned by uboot_blk_open.
+ *
+ * Return: the number of requests completed, negative on failure.
+ */
+int uboot_blk_process(int handle);
+
+/**
+ * uboot_blk_complete() - Collect completions of processed requests.
+ *
+ * @handle: handle returned by uboot_blk_open.
+ * @completions: array to populate with completions, oldest first.
+ * @max: the length of the completions array.
+ *
+ * Return: the number of completions returned, negative on failure.
+ */
+int uboot_blk_complete(int handle, struct uboot_blk_completion *completions, int max);
+
+/**
+ * uboot_blk_set_notify() - Request a Microkit notification on the given
+ *    channel each time uboot_blk_process completes a batch of requests.
+ *    This allows a client protection domain sharing the request buffers to
+ *    be told of completion.
+ *
+ * @handle: handle returned by uboot_blk_open.
+ * @channel: the channel to notify, or -1 for no notification.
+ */
+void uboot_blk_set_notify(int handle, int channel);
+
+/**
+ * struct uboot_blk_cache_stats - block cache statistics.
+ *
+ * @hits: the number of blocks read from the cache.
+ * @misses: the number of blocks read from the device.
+ * @evictions: the number of blocks discarded to make room for others.
+ * @flushes: the number of writes made to write back dirty blocks.
+ * @blocks_dirty: the number of blocks held that are not yet written to the
+ *    device (write-back only).
+ * @readahead: the number of blocks read ahead of sequential reads.
+ * @blocks_pinned: the number of pinned blocks currently held.
+ * @blocks_pinned_max: the capacity of the pinned range in blocks.
+ * @blocks_cached: the number of blocks currently held.
+ * @blocks_max: the capacity of the cache in blocks.
+ */
+struct uboot_blk_cache_stats {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long flushes;
+    unsigned long blocks_dirty;
+    unsigned long readahead;
+    unsigned long blocks_pinned;
+    unsigned long blocks_pinned_max;
+    unsigned long blocks_cached;
+    unsigned long blocks_max;
+};
+
+/**
+ * uboot_blk_cache_get_stats() - Return statistics for the block cache.
+ *
+ * @stats: populated with the statistics.
+ *
+ * Return: 0 if OK, otherwise failure (e.g. the cache is disabled).
+ */
+int uboot_blk_cache_get_stats(struct uboot_blk_cache_stats *stats);
+
+/**
+ * uboot_blk_cache_invalidate() - Discard all blocks held by the block
+ *    cache, e.g. if the device may have been modified by other means.
+ */
+void uboot_blk_cache_invalidate(void);
+
+/**
+ * uboot_fs_open() - Open a file for appending. The device and partition
+ *    are resolved once and retained by the handle. The file is created on
+ *    the first write if it does not already exist. For FAT partitions, the
+ *    start of the allocation table is pinned in the block cache when
+ *    LIB_UBOOT_BLK_CACHE_PIN_BLOCKS is set.
+ *
+ * @if_typename: the interface type of the device, e.g. "mmc" or "usb".
+ * @dev_part_str: the device and partition, e.g. "0:1".
+ * @filename: the file to append to.
+ *
+ * Return: a non-negative handle if OK, otherwise failure.
+ */
+int uboot_fs_open(const char *if_typename, const char *dev_part_str, const char *filename);
+
+/**
+ * uboot_fs_append() - Append data to an open file. Data is buffered and
+ *    may not be written to the device until uboot_fs_sync or
+ *    uboot_fs_close is called.
+ *
+ * @handle: handle returned by uboot_fs_open.
+ * @data: the data to append.
+ * @length: the number of bytes to append.
+ *
+ * Once appended, data is retained by the handle until written, so a failed
+ * uboot_fs_sync should not be followed by appending the same data again.
+ * If appending fails, the data of the call that had not been written to
+ * the device is discarded; data from earlier calls is retained.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_fs_append(int handle, const void *data, size_t length);
+
+/**
+ * uboot_fs_sync() - Write any buffered data to the device. Once complete
+ *    the data is durable, including any held by the block cache.
+ *
+ * @handle: handle returned by uboot_fs_open.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_fs_sync(int handle);
+
+/**
+ * uboot_fs_close() - Write any buffered data to the device and release the
+ *    handle.
+ *
+ * @handle: handle returned by uboot_fs_open.
+ *
+ * Return: 0 if OK, otherwise failure.
+ */
+int uboot_fs_close(int handle);
+
 /**
  * shutdown_uboot_drivers() - shutdown the u-boot driver library.
  */
@@ -5,10 +5,20 @@
  * 
  */
 
+/* Whether the platform's timer can be read. The dummy timer asserts if
+ * read, so initialisation is only timed and profiled with a real timer. */
+#ifndef UBOOT_HAVE_TIMER
+#define UBOOT_HAVE_TIMER 0
+#endif
+
 void initialise_and_start_timer(void);
 
 void shutdown_timer(void);
 
+/* Convert a count of system counter ticks, as returned by get_ticks, to
+ * microseconds */
+unsigned long timer_ticks_to_us(uint64_t ticks);
+
 void udelay(unsigned long);
 
 void wrap_mdelay(unsigned int);
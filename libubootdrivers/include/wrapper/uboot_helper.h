@@ -63,7 +63,9 @@
 #define __iomem			/* __attribute__((iomem)) */
 
 /* Assorted macros needed to keep U-Boot source code happy */
-#define CONFIG_SYS_RX_ETH_BUFFER    4
+#ifndef CONFIG_SYS_RX_ETH_BUFFER
+#define CONFIG_SYS_RX_ETH_BUFFER    4 /* Normally set from CMake */
+#endif
 #define CONFIG_LINKER_LIST_ALIGN    0
 #define CONFIG_ERR_PTR_OFFSET   	0
 #define CONFIG_NR_DRAM_BANKS		0 /* Not used */
@@ -107,7 +109,6 @@ typedef long off_t;
 #include <vsprintf.h>
 #include <assert.h>
 #include <plat_driver_data.h>
-#include <driver_data_limits.h>
 #include <linux/libfdt_env.h>
 #include <linux/libfdt.h>
 
@@ -7,19 +7,251 @@
 
  #include <io_dma.h>
 
-/* Routines to perform initialisation and shutdown of the U-Boot wrapper.
- * The initialise routine performs the actions that would normally be
- * performed by U-Boot when it is started.
+/* A library context. Each context has its own U-Boot global data, and so
+ * its own device tree, driver model and environment, and its own DMA
+ * manager. Only one context is in use at a time; the library's routines
+ * act on the context last selected.
  */
 
+struct global_data;
 
-int initialise_uboot_wrapper(char* fdt_blob);
+/* Arena from which the live tree and driver model structures are allocated
+ * while a context is initialised (see uboot_arena.c).
+ */
+
+struct uboot_arena {
+    char *base;
+    size_t size;
+    // Bytes allocated from the arena, and bytes that did not fit.
+    size_t used;
+    size_t overflow;
+    // Whether allocations are currently made from the arena.
+    bool active;
+    struct uboot_arena *next;
+};
+
+/* Profile of a context's initialisation (see uboot_profile.c). Times are
+ * held as system counter values.
+ */
+
+#define UBOOT_PROFILE_MAX_PHASES 32
+
+struct uboot_profile_record {
+    const char *name;
+    uint64_t start_ticks;
+    uint64_t end_ticks;
+};
+
+struct uboot_profile {
+    // Counter value at which initialisation of the context started.
+    uint64_t start_ticks;
+    int count;
+    struct uboot_profile_record records[UBOOT_PROFILE_MAX_PHASES];
+};
+
+struct uboot_alias;
+
+struct uboot_ctx {
+    // Copy of the DMA manager supplied at initialisation.
+    ps_dma_man_t dma_manager;
+    // The context's copy of the FDT, NULL if the original FDT is used.
+    void *fdt_copy;
+    // The U-Boot global data ('gd') of the context.
+    struct global_data *gd;
+    // Arena holding the context's live tree and driver model structures.
+    struct uboot_arena arena;
+    // Profile of the context's initialisation.
+    struct uboot_profile profile;
+    // Aliases of the context's device tree (see uboot_aliases.c).
+    struct uboot_alias *aliases;
+    // Whether the context has been initialised, and whether the MMC and
+    // Ethernet devices have been probed.
+    bool initialised;
+    bool mmc_initialised;
+    bool eth_initialised;
+    // Whether 'usb start' has been recorded in the profile.
+    bool usb_start_profiled;
+    // Time (in microseconds) at which initialisation of the context started,
+    // on platforms with a timer.
+    unsigned long init_start_us;
+    // Position of the next device to probe through uboot_init_step.
+    int init_step_uclass;
+    int init_step_device;
+};
+
+/* Routines to perform initialisation and shutdown of the U-Boot wrapper for
+ * a context. The initialise routine performs the actions that would
+ * normally be performed by U-Boot when it is started, and selects the
+ * context. Select makes a context the one in use.
+ */
+
+int initialise_uboot_wrapper(struct uboot_ctx *ctx, char* fdt_blob);
+
+void shutdown_uboot_wrapper(struct uboot_ctx *ctx);
+
+void uboot_wrapper_select(struct uboot_ctx *ctx);
+
+/* Routines recording the profile of a context's initialisation. Start
+ * clears the profile; begin records the start of a phase, returning the
+ * phase to pass to end (negative if the profile is full). Get profile
+ * returns the profile of the selected context.
+ */
+
+void uboot_profile_start(struct uboot_profile *profile);
+
+int uboot_profile_begin(struct uboot_profile *profile, const char *name);
+
+void uboot_profile_end(struct uboot_profile *profile, int phase);
+
+struct uboot_profile *uboot_wrapper_get_profile(void);
+
+/* Returns the selected context, NULL if none.
+ */
+
+struct uboot_ctx *uboot_wrapper_get_ctx(void);
+
+/* Returns the list of device tree aliases of the selected context, NULL if
+ * no context is selected.
+ */
+
+struct uboot_alias **uboot_wrapper_get_aliases(void);
+
+/* Returns whether the U-Boot wrapper has been successfully initialised. Used
+ * by the library's API routines to reject calls made before initialisation.
+ */
+
+bool uboot_wrapper_is_initialised(void);
+
+/* Live device tree generated at build time by scripts/gen_live_tree.py, with
+ * the status of each node already set for the protection domain's devices,
+ * and the device paths it was generated for. Only used, and so only needs to
+ * be linked in, when the library is built with UBOOT_LIVE_TREE.
+ */
+
+#ifndef UBOOT_LIVE_TREE
+#define UBOOT_LIVE_TREE 0
+#endif
+
+struct device_node;
+
+extern struct device_node *uboot_live_tree;
+extern const char *const uboot_live_tree_paths[];
+extern const int uboot_live_tree_path_count;
+
+/* Probe the MMC or Ethernet devices if not already probed. When the library
+ * is built for lazy probing (LIB_UBOOT_LAZY_PROBE) these are not probed at
+ * initialisation, and must be ensured by any routine using them. The
+ * command variant ensures the devices required by a command string.
+ */
+
+int uboot_wrapper_ensure_mmc(void);
+
+int uboot_wrapper_ensure_eth(void);
+
+int uboot_wrapper_ensure_for_command(const char *cmd);
+
+/* Find a command by name through the generated hash of command names. Falls
+ * back to U-Boot's search of the command table for abbreviated names.
+ */
 
-void shutdown_uboot_wrapper(void);
+struct cmd_tbl;
 
-/* Routines for start up and shutdown of DMA management */
+struct cmd_tbl *uboot_command_find(const char *name);
+
+/* Run a command that needs none of the command line parser's features by
+ * calling it directly. Returns the result as run_command would, or -EAGAIN
+ * if the command must be run through the command line parser.
+ */
+
+int uboot_command_run_direct(const char *cmd, int flag);
+
+/* Record the time taken and result of a command run through
+ * run_uboot_command in the command statistics (see uboot_command_stats.c).
+ */
+
+void uboot_command_stats_record(const char *cmd, unsigned long elapsed_us, int ret);
+
+/* Free the index of compatible strings used to bind devices, once no context
+ * remains, returning the number of bytes freed. The index is built again if
+ * more devices are bound.
+ */
+
+unsigned long uboot_bind_index_release(void);
+
+/* Close the block device and file handles opened while a context was
+ * selected. The context must be selected. Handles can only be used while
+ * the context that opened them is selected.
+ */
+
+void uboot_blk_close_all(struct uboot_ctx *ctx);
+
+void uboot_fs_close_all(struct uboot_ctx *ctx);
+
+/* Routines for start up and shutdown of the block cache. The cache is
+ * interposed on the MMC block driver so must be started once the driver
+ * model has been initialised.
+ */
+
+int uboot_blk_cache_init(void);
+
+void uboot_blk_cache_shutdown(void);
+
+/* Write back and remove all blocks from the block cache, and forget any
+ * devices it refers to, before the devices of a context are released.
+ */
+
+void uboot_blk_cache_purge(void);
+
+/* Write any blocks held dirty by the block cache to the given device, or to
+ * all devices if NULL. Returns 0 if all were written.
+ */
+
+struct udevice;
+
+int uboot_blk_cache_flush(struct udevice *dev);
+
+/* Pin a range of blocks of a device in the block cache, replacing any range
+ * pinned previously. Blocks are loaded into the pinned range as they are
+ * read. Only as many blocks as the pinned range can hold are pinned.
+ */
+
+int uboot_blk_cache_pin(struct udevice *dev, unsigned long start, unsigned long blkcnt);
+
+/* Routines managing a context's initialisation arena. Create allocates the
+ * arena and select makes it the arena of the selected context. While set
+ * active, allocations are made from the arena. Suspend stops allocations from
+ * the selected context's arena, returning whether it was active, for state
+ * that outlives the context; resume restores it. Report logs the use of the
+ * arena and release frees it with everything allocated from it.
+ */
+
+int uboot_arena_create(struct uboot_arena *arena);
+
+void uboot_arena_select(struct uboot_arena *arena);
+
+void uboot_arena_set_active(struct uboot_arena *arena, bool active);
+
+bool uboot_arena_suspend(void);
+
+void uboot_arena_resume(bool active);
+
+void uboot_arena_report(struct uboot_arena *arena);
+
+void uboot_arena_release(struct uboot_arena *arena);
+
+/* Remove the stdio devices registered while a context was selected, given
+ * its global data, from U-Boot's device list (see uboot_stub/common/console.c).
+ */
+
+void stdio_remove_owned(const struct global_data *owner);
+
+/* Routines for start up and shutdown of DMA management. Initialise selects
+ * the DMA manager used for new allocations; allocations are released
+ * through the manager that made them. Shutdown frees all allocations made
+ * through a manager.
+ */
 
 void sel4_dma_initialise(ps_dma_man_t *dma_manager);
 
-void sel4_dma_shutdown(void);
+void sel4_dma_shutdown(ps_dma_man_t *dma_manager);
 
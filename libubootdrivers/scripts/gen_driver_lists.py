@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022, Capgemini Engineering
+#
+# SPDX-License-Identifier: BSD-2-Clause
+#
+
+"""Generate the linker script fragment placing U-Boot's linker lists.
+
+U-Boot collects its drivers, uclass drivers, commands and similar entries
+into 'linker lists': arrays assembled by the linker from entries declared
+throughout the source. The library's linker_lists.h places each entry in its
+own section. This script reads the entries used on a platform, in order,
+from the 'extern' declarations of the platform's plat_driver_data.h and
+writes a linker script fragment that places each list's entries one after
+another, with symbols marking the start and end of each list.
+
+The entries are referenced by the fragment, so are linked from the library
+without any other reference to them.
+
+A C source file indexing the commands by name is also written. The index is
+a perfect hash: the seed of the hash is chosen so that each command name
+falls in its own slot of the table, allowing a command to be found with a
+single string comparison whatever the number of commands.
+
+Usage: gen_driver_lists.py <plat_driver_data.h> <output linker script> <output command index>
+"""
+
+import re
+import sys
+
+# All lists used by the library, in the order they are placed.
+LISTS = [
+    "uclass_driver",
+    "driver",
+    "usb_driver_entry",
+    "part_driver",
+    "cmd",
+    "env_driver",
+    "env_clbk",
+    "driver_info",
+    "udevice",
+]
+
+
+def parse_entries(header):
+    entries = {name: [] for name in LISTS}
+    pattern = r"^\s*extern\s+(?:const\s+)?struct\s+\w+\s+_u_boot_(\w+?)__(\w+)\s*;"
+    for match in re.finditer(pattern, header, re.MULTILINE):
+        list_name, entry = match.groups()
+        if list_name not in entries:
+            sys.exit("Unknown linker list '%s'" % list_name)
+        entries[list_name].append(entry)
+    return entries
+
+
+def generate(entries, source_name):
+    out = []
+    out.append("/*")
+    out.append(" * Generated by gen_driver_lists.py from %s. Do not edit." % source_name)
+    out.append(" */")
+    out.append("")
+    for list_name in LISTS:
+        for entry in entries[list_name]:
+            out.append("EXTERN(_u_boot_%s__%s)" % (list_name, entry))
+    out.append("")
+    out.append("SECTIONS")
+    out.append("{")
+    out.append("    .u_boot_list : {")
+    for list_name in LISTS:
+        out.append("        . = ALIGN(8);")
+        out.append("        __u_boot_list_%s_start = .;" % list_name)
+        for entry in entries[list_name]:
+            out.append("        KEEP(*(.u_boot_list_2_%s_2_%s))" % (list_name, entry))
+        out.append("        __u_boot_list_%s_end = .;" % list_name)
+    out.append("    }")
+    out.append("}")
+    out.append("INSERT AFTER .data;")
+    out.append("")
+    return "\n".join(out)
+
+
+def hash_name(name, seed):
+    """FNV-1a hash of a name, starting from the given seed, with the high
+    bits folded into the low bits used to select a slot. Must match
+    hash_command_name() in uboot_command.c."""
+    value = seed
+    for byte in name.encode():
+        value ^= byte
+        value = (value * 16777619) & 0xffffffff
+    return value ^ (value >> 16)
+
+
+def find_perfect_hash(names):
+    """Return the seed and table size placing every name in its own slot."""
+    size = 1
+    while size < 2 * len(names):
+        size <<= 1
+    while True:
+        for seed in range(2166136261, 2166136261 + 100000):
+            slots = set(hash_name(name, seed) & (size - 1) for name in names)
+            if len(slots) == len(names):
+                return seed, size
+        size <<= 1
+
+
+def generate_command_index(commands, source_name):
+    seed, size = find_perfect_hash(commands)
+    table = {hash_name(name, seed) & (size - 1): name for name in commands}
+
+    out = []
+    out.append("/*")
+    out.append(" * Generated by gen_driver_lists.py from %s. Do not edit." % source_name)
+    out.append(" */")
+    out.append("")
+    out.append("#include <command.h>")
+    out.append("")
+    for name in commands:
+        out.append("extern struct cmd_tbl _u_boot_cmd__%s;" % name)
+    out.append("")
+    out.append("const unsigned int uboot_command_hash_seed = %uU;" % seed)
+    out.append("const unsigned int uboot_command_hash_mask = %u;" % (size - 1))
+    out.append("")
+    out.append("struct cmd_tbl *const uboot_command_hash_table[%u] = {" % size)
+    for slot in sorted(table):
+        out.append("    [%u] = &_u_boot_cmd__%s," % (slot, table[slot]))
+    out.append("};")
+    out.append("")
+    return "\n".join(out)
+
+
+def main(argv):
+    if len(argv) != 4:
+        sys.exit(__doc__.strip().splitlines()[-1])
+
+    with open(argv[1]) as f:
+        entries = parse_entries(f.read())
+
+    with open(argv[2], "w") as f:
+        f.write(generate(entries, argv[1].split("/")[-1]))
+
+    with open(argv[3], "w") as f:
+        f.write(generate_command_index(entries["cmd"], argv[1].split("/")[-1]))
+
+
+if __name__ == "__main__":
+    main(sys.argv)
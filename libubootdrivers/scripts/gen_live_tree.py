@@ -0,0 +1,281 @@
+#!/usr/bin/env python3
+#
+# Copyright 2022, Capgemini Engineering
+#
+# SPDX-License-Identifier: BSD-2-Clause
+#
+
+"""Generate a pre-unflattened U-Boot live device tree.
+
+Reads a flattened device tree blob and the DEV_PATHS list from a protection
+domain's platform devices header, and writes a C source file containing the
+equivalent U-Boot live tree ('struct device_node' and 'struct property'
+arrays). The status of each node is set as initialise_uboot_drivers would
+set it at run time: nodes on the path to, or beneath, a listed device are
+'okay' and all other nodes are 'disabled'. All nodes are retained so that
+phandle references from enabled nodes to disabled nodes remain valid.
+
+The DEV_PATHS are also written, so that the library can check they match
+those it is initialised with. When the generated file is linked into a
+protection domain the library uses the tree directly, rather than copying the FDT, pruning it and building the
+live tree on the heap at start up.
+
+Usage: gen_live_tree.py <dtb> <platform devices header> <output C file>
+"""
+
+import re
+import struct
+import sys
+
+FDT_MAGIC = 0xd00dfeed
+FDT_BEGIN_NODE = 1
+FDT_END_NODE = 2
+FDT_PROP = 3
+FDT_NOP = 4
+FDT_END = 9
+
+
+class Node:
+    def __init__(self, name, parent):
+        self.name = name
+        self.parent = parent
+        self.children = []
+        self.props = []
+        if parent is None:
+            self.path = "/"
+        elif parent.parent is None:
+            self.path = "/" + name
+        else:
+            self.path = parent.path + "/" + name
+
+
+def align(offset, alignment=4):
+    return (offset + alignment - 1) & ~(alignment - 1)
+
+
+def parse_dtb(blob):
+    (magic, _, off_struct, off_strings, _, version) = struct.unpack_from(">6I", blob, 0)
+    if magic != FDT_MAGIC:
+        sys.exit("Not a flattened device tree")
+    if version < 0x10:
+        sys.exit("Device tree version %d not supported" % version)
+
+    def string_at(offset):
+        end = blob.index(b"\0", offset)
+        return blob[offset:end].decode()
+
+    root = None
+    node = None
+    offset = off_struct
+    while True:
+        (token,) = struct.unpack_from(">I", blob, offset)
+        offset += 4
+        if token == FDT_BEGIN_NODE:
+            name = string_at(offset)
+            offset = align(offset + len(name) + 1)
+            node = Node(name, node)
+            if node.parent is None:
+                root = node
+            else:
+                node.parent.children.append(node)
+        elif token == FDT_END_NODE:
+            node = node.parent
+        elif token == FDT_PROP:
+            (length, name_offset) = struct.unpack_from(">2I", blob, offset)
+            offset += 8
+            node.props.append([string_at(off_strings + name_offset),
+                               blob[offset:offset + length]])
+            offset = align(offset + length)
+        elif token == FDT_NOP:
+            continue
+        elif token == FDT_END:
+            return root
+        else:
+            sys.exit("Bad device tree token %d" % token)
+
+
+def parse_dev_paths(header):
+    """Return the DEV_PATHS list from a platform devices header, expanding
+    the macros it refers to."""
+    text = header.replace("\\\n", " ")
+    defines = {}
+    for match in re.finditer(r"^\s*#define\s+(\w+)\s+(.*)$", text, re.MULTILINE):
+        defines[match.group(1)] = match.group(2).strip()
+
+    def expand(token):
+        token = token.strip()
+        while token in defines:
+            token = defines[token]
+        if not re.fullmatch(r'"[^"]*"', token):
+            sys.exit("Unable to expand device path '%s'" % token)
+        return token[1:-1]
+
+    if "DEV_PATHS" not in defines:
+        sys.exit("No DEV_PATHS in header")
+    body = re.search(r"\{(.*)\}", defines["DEV_PATHS"]).group(1)
+    return [expand(token) for token in body.split(",") if token.strip()]
+
+
+def find_node(root, path):
+    node = root
+    for name in filter(None, path.split("/")):
+        matches = [c for c in node.children if c.name == name]
+        if not matches:
+            sys.exit("Device path '%s' not found in device tree" % path)
+        node = matches[0]
+    return node
+
+
+def set_status(root, dev_paths):
+    """Set the status of every node as disable_not_required_devices would."""
+    okay = set()
+    for path in dev_paths:
+        node = find_node(root, path)
+        ancestor = node
+        while ancestor is not None:
+            okay.add(ancestor)
+            ancestor = ancestor.parent
+        stack = [node]
+        while stack:
+            current = stack.pop()
+            okay.add(current)
+            stack.extend(current.children)
+
+    stack = [root]
+    while stack:
+        node = stack.pop()
+        value = (b"okay\0" if node in okay else b"disabled\0")
+        for prop in node.props:
+            if prop[0] == "status":
+                prop[1] = value
+                break
+        else:
+            node.props.append(["status", value])
+        stack.extend(node.children)
+
+
+def c_string(text):
+    return '"' + text.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def generate(root, dev_paths, source_name):
+    nodes = []
+    stack = [root]
+    while stack:
+        node = stack.pop()
+        nodes.append(node)
+        stack.extend(reversed(node.children))
+    index = {node: i for i, node in enumerate(nodes)}
+
+    # All property values are held in a single pool, each starting on a four
+    # byte boundary as they would within the FDT.
+    pool = bytearray()
+    props = []
+    node_props = []
+    node_info = []
+    for node in nodes:
+        first = len(props)
+        name_offset = None
+        type_offset = None
+        phandle = 0
+        values = list(node.props)
+        # U-Boot adds a 'name' property (the node name less any unit
+        # address) after the node's own properties if none is present.
+        if not any(name == "name" for name, _ in values):
+            values.append(["name", node.name.split("@")[0].encode() + b"\0"])
+        for name, value in values:
+            offset = len(pool)
+            pool += value
+            pool += bytes(align(len(pool)) - len(pool))
+            props.append((name, offset, len(value)))
+            if name == "name" and name_offset is None:
+                name_offset = offset
+            if name == "device_type" and type_offset is None:
+                type_offset = offset
+            if name in ("phandle", "linux,phandle") and phandle == 0 and len(value) >= 4:
+                (phandle,) = struct.unpack(">I", value[:4])
+        node_props.append((first, len(props)))
+        node_info.append((name_offset, type_offset, phandle))
+
+    out = []
+    out.append("/*")
+    out.append(" * Generated by gen_live_tree.py from %s. Do not edit." % source_name)
+    out.append(" */")
+    out.append("")
+    out.append("#include <dm/of.h>")
+    out.append("")
+    out.append("#define LIVE_TREE_NODES %d" % len(nodes))
+    out.append("#define LIVE_TREE_PROPS %d" % len(props))
+    out.append("")
+    out.append("static struct device_node live_nodes[LIVE_TREE_NODES];")
+    out.append("static struct property live_props[LIVE_TREE_PROPS];")
+    out.append("")
+    out.append("static unsigned char live_values[%d] __aligned(4) = {" % max(len(pool), 1))
+    for i in range(0, len(pool), 16):
+        out.append("    " + " ".join("0x%02x," % b for b in pool[i:i + 16]))
+    out.append("};")
+    out.append("")
+    out.append("static struct property live_props[LIVE_TREE_PROPS] = {")
+    for first, last in node_props:
+        for i in range(first, last):
+            name, offset, length = props[i]
+            next_prop = ("&live_props[%d]" % (i + 1)) if i + 1 < last else "NULL"
+            out.append("    [%d] = { .name = %s, .length = %d, .value = &live_values[%d], .next = %s }," %
+                       (i, c_string(name), length, offset, next_prop))
+    out.append("};")
+    out.append("")
+    out.append("static struct device_node live_nodes[LIVE_TREE_NODES] = {")
+    for i, node in enumerate(nodes):
+        first, last = node_props[i]
+        name_offset, type_offset, phandle = node_info[i]
+        siblings = node.parent.children if node.parent else [node]
+        position = siblings.index(node)
+        fields = [
+            ".name = (const char *)&live_values[%d]" % name_offset,
+            ".type = %s" % ("(const char *)&live_values[%d]" % type_offset
+                            if type_offset is not None else '"<NULL>"'),
+            ".phandle = %d" % phandle,
+            ".full_name = %s" % c_string(node.path),
+            ".properties = %s" % ("&live_props[%d]" % first if last > first else "NULL"),
+            ".parent = %s" % ("&live_nodes[%d]" % index[node.parent] if node.parent else "NULL"),
+            ".child = %s" % ("&live_nodes[%d]" % index[node.children[0]]
+                             if node.children else "NULL"),
+            ".sibling = %s" % ("&live_nodes[%d]" % index[siblings[position + 1]]
+                               if position + 1 < len(siblings) else "NULL"),
+        ]
+        out.append("    [%d] = {" % i)
+        for field in fields:
+            out.append("        %s," % field)
+        out.append("    },")
+    out.append("};")
+    out.append("")
+    out.append("struct device_node *uboot_live_tree = &live_nodes[0];")
+    out.append("")
+    # The device paths the tree was generated for, checked against those
+    # passed to the library at run time.
+    out.append("const char *const uboot_live_tree_paths[] = {")
+    for path in dev_paths:
+        out.append("    %s," % c_string(path))
+    out.append("};")
+    out.append("const int uboot_live_tree_path_count = %d;" % len(dev_paths))
+    out.append("")
+    return "\n".join(out)
+
+
+def main(argv):
+    if len(argv) != 4:
+        sys.exit(__doc__.strip().splitlines()[-1])
+
+    with open(argv[1], "rb") as f:
+        root = parse_dtb(f.read())
+    with open(argv[2]) as f:
+        dev_paths = parse_dev_paths(f.read())
+
+    set_status(root, dev_paths)
+
+    with open(argv[3], "w") as f:
+        f.write(generate(root, dev_paths, argv[1].split("/")[-1]))
+
+
+if __name__ == "__main__":
+    main(sys.argv)
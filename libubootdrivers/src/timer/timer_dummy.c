@@ -21,6 +21,10 @@ unsigned long timer_get_us(void) {
     assert(false);
 }
 
+unsigned long timer_ticks_to_us(uint64_t ticks) {
+    assert(false);
+}
+
 unsigned long timer_get_ms(void) {
     assert(false);
 }
@@ -84,6 +84,12 @@ unsigned long timer_get_us(void) {
     return (get_ticks() << 7) / ticks_per_us;
 }
 
+unsigned long timer_ticks_to_us(uint64_t ticks) {
+    u64 ticks_per_us = ((u64)tick_frequency << 7) / 1000000;
+
+    return (ticks << 7) / ticks_per_us;
+}
+
 unsigned long timer_get_ms(void) {
     return timer_get_us() / 1000;
 }
@@ -23,6 +23,8 @@ struct dma_allocation_t {
     size_t size;
     /* Additional data relevant only to DMA mappings */
     enum dma_data_direction mapping_dir;
+    /* The DMA manager that made the allocation */
+    ps_dma_man_t *manager;
 };
 
 static struct dma_allocation_t dma_alloc[MAX_DMA_ALLOCS];
@@ -91,6 +93,7 @@ static void clear_allocation(int alloc_index)
     dma_alloc[alloc_index].paddr = 0;
     dma_alloc[alloc_index].size = 0;
     dma_alloc[alloc_index].mapping_dir = DMA_NONE;
+    dma_alloc[alloc_index].manager = NULL;
 }
 
 void *sel4_dma_phys_to_virt(void *paddr)
@@ -175,7 +178,7 @@ void sel4_dma_flush_range(void *start, void *stop)
             ((void*) start - dma_alloc[alloc_index].public_vaddr);
 
     /* Perform the flush */
-    sel4_dma_manager->dma_cache_op_fn(
+    dma_alloc[alloc_index].manager->dma_cache_op_fn(
         flush_start,
         flush_size,
         DMA_CACHE_OP_CLEAN);
@@ -216,7 +219,7 @@ void sel4_dma_invalidate_range(void *start, void *stop)
     void *inval_start = dma_alloc[alloc_index].mapped_vaddr +
             ((void*) start - dma_alloc[alloc_index].public_vaddr);
 
-    sel4_dma_manager->dma_cache_op_fn(
+    dma_alloc[alloc_index].manager->dma_cache_op_fn(
         inval_start,
         inval_size,
         DMA_CACHE_OP_INVALIDATE);
@@ -232,8 +235,6 @@ void sel4_dma_invalidate_range(void *start, void *stop)
 
 void sel4_dma_free(void *vaddr)
 {
-    assert(sel4_dma_manager != NULL);
-
     // Find the previous allocation.
     int alloc_index = find_allocation_index_by_public_vaddr(vaddr);
     if (alloc_index < 0) {
@@ -243,7 +244,7 @@ void sel4_dma_free(void *vaddr)
 
     UBOOT_LOGD("vaddr = %p, alloc_index = %i", vaddr, alloc_index);
 
-    sel4_dma_manager->dma_free_fn(
+    dma_alloc[alloc_index].manager->dma_free_fn(
         dma_alloc[alloc_index].mapped_vaddr,
         dma_alloc[alloc_index].size);
 
@@ -296,6 +297,7 @@ void* sel4_dma_memalign(size_t align, size_t size)
     // Not a mapping.
     dma_alloc[alloc_index].is_mapping = false;
     dma_alloc[alloc_index].mapping_dir = DMA_NONE;
+    dma_alloc[alloc_index].manager = sel4_dma_manager;
 
     return mapped_vaddr;
 }
@@ -308,21 +310,21 @@ void* sel4_dma_malloc(size_t size)
 
 void sel4_dma_initialise(ps_dma_man_t *dma_manager)
 {
+    // Allocations made through other DMA managers (i.e. by other library
+    // contexts) are retained.
     sel4_dma_manager = dma_manager;
-
-    for (int x = 0; x < MAX_DMA_ALLOCS; x++)
-        clear_allocation(x);
 }
 
-void sel4_dma_shutdown(void)
+void sel4_dma_shutdown(ps_dma_man_t *dma_manager)
 {
-    // Deallocate any currently allocated DMA.
+    // Deallocate any DMA currently allocated through this manager.
     for (int x = 0; x < MAX_DMA_ALLOCS; x++)
-        if (dma_alloc[x].in_use)
+        if (dma_alloc[x].in_use && dma_alloc[x].manager == dma_manager)
             sel4_dma_free(dma_alloc[x].public_vaddr);
 
-    // Clear the pointer to the DMA routines.
-    sel4_dma_manager = NULL;
+    // Clear the pointer to the DMA routines if in use.
+    if (sel4_dma_manager == dma_manager)
+        sel4_dma_manager = NULL;
 }
 
 /* Routines to support an implementation of the linux 'DMA mapping' API */
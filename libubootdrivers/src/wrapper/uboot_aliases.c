@@ -0,0 +1,129 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides the device tree aliases (e.g. 'mmc0') of each context.
+ * U-Boot's of_alias_scan adds the aliases of the live tree to a single list
+ * held by U-Boot, which has no means of removing them; with several contexts
+ * the list would hold the aliases of every context's tree, including those
+ * of contexts since shut down.
+ *
+ * Calls to of_alias_scan and to the routines looking up aliases are instead
+ * directed here (through the linker's --wrap option). Scanning records the
+ * aliases of the selected context's tree in a list held by the context, and
+ * lookups search the list of the selected context. The list is allocated
+ * from the context's initialisation arena, so is released with it.
+ *
+ * U-Boot's own scan is still made, so that its references to the tree's
+ * '/aliases' and '/chosen' nodes are set, but from the heap as its list
+ * outlives the context.
+ */
+
+#include <uboot_helper.h>
+#include <dm/of.h>
+#include <dm/of_access.h>
+#include <linux/ctype.h>
+#include <uboot_wrapper.h>
+
+struct uboot_alias {
+    struct uboot_alias *next;
+    struct device_node *np;
+    int id;
+    // The alias without its trailing id, e.g. 'mmc' for 'mmc0'.
+    char stem[];
+};
+
+int __real_of_alias_scan(void);
+
+int __wrap_of_alias_scan(void)
+{
+    struct uboot_alias **aliases = uboot_wrapper_get_aliases();
+    if (aliases == NULL)
+        return -EINVAL;
+
+    // The aliases held by U-Boot are never released.
+    bool arena_active = uboot_arena_suspend();
+    int ret = __real_of_alias_scan();
+    uboot_arena_resume(arena_active);
+    if (ret)
+        return ret;
+
+    *aliases = NULL;
+
+    struct device_node *aliases_node = of_find_node_by_path("/aliases");
+    if (aliases_node == NULL)
+        return 0;
+
+    for (struct property *pp = aliases_node->properties; pp != NULL; pp = pp->next) {
+        if (!strcmp(pp->name, "name") || !strcmp(pp->name, "phandle") ||
+            !strcmp(pp->name, "linux,phandle"))
+            continue;
+
+        struct device_node *np = of_find_node_by_path(pp->value);
+        if (np == NULL)
+            continue;
+
+        // Split the alias into its stem and trailing id, ignoring aliases
+        // with no id.
+        const char *start = pp->name;
+        const char *end = start + strlen(start);
+        while (end > start && isdigit(end[-1]))
+            end--;
+        if (*end == '\0')
+            continue;
+
+        size_t length = end - start;
+        struct uboot_alias *alias = calloc(1, sizeof(*alias) + length + 1);
+        if (alias == NULL)
+            return -ENOMEM;
+        alias->np = np;
+        alias->id = simple_strtoul(end, NULL, 10);
+        memcpy(alias->stem, start, length);
+        alias->next = *aliases;
+        *aliases = alias;
+    }
+
+    return 0;
+}
+
+int __wrap_of_alias_get_id(const struct device_node *np, const char *stem)
+{
+    struct uboot_alias **aliases = uboot_wrapper_get_aliases();
+    if (aliases == NULL)
+        return -ENODEV;
+
+    for (struct uboot_alias *alias = *aliases; alias != NULL; alias = alias->next)
+        if (alias->np == np && !strcmp(alias->stem, stem))
+            return alias->id;
+
+    return -ENODEV;
+}
+
+int __wrap_of_alias_get_highest_id(const char *stem)
+{
+    struct uboot_alias **aliases = uboot_wrapper_get_aliases();
+    int id = -1;
+
+    if (aliases == NULL)
+        return id;
+
+    for (struct uboot_alias *alias = *aliases; alias != NULL; alias = alias->next)
+        if (alias->id > id && !strcmp(alias->stem, stem))
+            id = alias->id;
+
+    return id;
+}
+
+struct device_node *__wrap_of_alias_get_dev(const char *stem, int id)
+{
+    struct uboot_alias **aliases = uboot_wrapper_get_aliases();
+    if (aliases == NULL)
+        return NULL;
+
+    for (struct uboot_alias *alias = *aliases; alias != NULL; alias = alias->next)
+        if (alias->id == id && !strcmp(alias->stem, stem))
+            return alias->np;
+
+    return NULL;
+}
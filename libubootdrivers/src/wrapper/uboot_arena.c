@@ -0,0 +1,215 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides the arena from which the live device tree and the
+ * driver model's devices and uclasses are allocated while a context is
+ * initialised. Building the live tree and binding devices otherwise makes
+ * many small allocations from the heap, fragmenting it and scattering
+ * related structures across memory.
+ *
+ * Calls to malloc and its relatives are directed here (through the linker's
+ * --wrap option). While the arena of the selected context is active,
+ * allocations are made by advancing a pointer through the arena; at all
+ * other times, or once the arena is full, they are passed to the C library.
+ * Freeing memory within an arena has no effect. The arena is released as a
+ * whole when its context is shut down, so state outliving the context (e.g.
+ * U-Boot's list of device tree aliases) is allocated with the arena
+ * suspended, and references held by the library's block cache and stdio
+ * devices to the context's devices are removed before it is released.
+ *
+ * The size of the arena is set by LIB_UBOOT_INIT_ARENA_SIZE. The amount
+ * used (and any excess allocated from the heap) is logged at the end of
+ * initialisation, from which the size can be set.
+ */
+
+#include <uboot_helper.h>
+#include <uboot_wrapper.h>
+
+#ifndef UBOOT_INIT_ARENA_SIZE
+#define UBOOT_INIT_ARENA_SIZE 0
+#endif
+
+// Alignment of allocations, as for malloc.
+#define ARENA_ALIGN 16
+
+// Each allocation is preceded by its size, for realloc.
+#define ARENA_HEADER sizeof(size_t)
+
+// Arena of the selected context, NULL if none.
+static struct uboot_arena *current_arena;
+
+// All arenas created and not yet released. Memory freed while another
+// context is selected may belong to any of them.
+static struct uboot_arena *arenas;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void *__real_memalign(size_t align, size_t size);
+void __real_free(void *ptr);
+
+/* Returns the arena holding an allocation, NULL if allocated from the heap. */
+static struct uboot_arena *find_arena(void *ptr)
+{
+    for (struct uboot_arena *arena = arenas; arena != NULL; arena = arena->next)
+        if ((char *)ptr >= arena->base && (char *)ptr < arena->base + arena->size)
+            return arena;
+
+    return NULL;
+}
+
+/* Allocate from the active arena. Returns NULL if no arena is active or the
+ * allocation does not fit. Arena memory is zeroed when the arena is created
+ * and never reused, so allocations are already zeroed. */
+static void *arena_alloc(size_t align, size_t size)
+{
+    struct uboot_arena *arena = current_arena;
+
+    if (arena == NULL || !arena->active)
+        return NULL;
+
+    uintptr_t next = (uintptr_t)arena->base + arena->used + ARENA_HEADER;
+    size_t start = ((next + align - 1) & ~(uintptr_t)(align - 1)) - (uintptr_t)arena->base;
+    if (start + size > arena->size || start + size < start) {
+        arena->overflow += size;
+        return NULL;
+    }
+
+    memcpy(arena->base + start - ARENA_HEADER, &size, ARENA_HEADER);
+    arena->used = start + size;
+    return arena->base + start;
+}
+
+/* Returns the size requested for an allocation from an arena. */
+static size_t arena_alloc_size(void *ptr)
+{
+    size_t size;
+
+    memcpy(&size, (char *)ptr - ARENA_HEADER, ARENA_HEADER);
+    return size;
+}
+
+int uboot_arena_create(struct uboot_arena *arena)
+{
+    memset(arena, 0, sizeof(*arena));
+
+    if (UBOOT_INIT_ARENA_SIZE == 0)
+        return 0;
+
+    arena->base = __real_calloc(1, UBOOT_INIT_ARENA_SIZE);
+    if (arena->base == NULL)
+        return -ENOMEM;
+    arena->size = UBOOT_INIT_ARENA_SIZE;
+    arena->next = arenas;
+    arenas = arena;
+
+    return 0;
+}
+
+void uboot_arena_select(struct uboot_arena *arena)
+{
+    current_arena = arena;
+}
+
+void uboot_arena_set_active(struct uboot_arena *arena, bool active)
+{
+    arena->active = active && arena->base != NULL;
+}
+
+bool uboot_arena_suspend(void)
+{
+    if (current_arena == NULL)
+        return false;
+
+    bool active = current_arena->active;
+    current_arena->active = false;
+    return active;
+}
+
+void uboot_arena_resume(bool active)
+{
+    if (current_arena != NULL)
+        uboot_arena_set_active(current_arena, active);
+}
+
+void uboot_arena_release(struct uboot_arena *arena)
+{
+    if (current_arena == arena)
+        current_arena = NULL;
+
+    for (struct uboot_arena **link = &arenas; *link != NULL; link = &(*link)->next) {
+        if (*link == arena) {
+            *link = arena->next;
+            break;
+        }
+    }
+
+    __real_free(arena->base);
+    memset(arena, 0, sizeof(*arena));
+}
+
+void uboot_arena_report(struct uboot_arena *arena)
+{
+    if (arena->base == NULL)
+        return;
+
+    if (arena->overflow)
+        UBOOT_LOGW("Init arena full: used %zu of %zu bytes, %zu bytes more from heap",
+            arena->used, arena->size, arena->overflow);
+    else
+        UBOOT_LOGI("Init arena used %zu of %zu bytes", arena->used, arena->size);
+}
+
+void *__wrap_malloc(size_t size)
+{
+    void *ptr = arena_alloc(ARENA_ALIGN, size);
+
+    return (ptr != NULL) ? ptr : __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    if (size != 0 && nmemb > SIZE_MAX / size)
+        return NULL;
+
+    void *ptr = arena_alloc(ARENA_ALIGN, nmemb * size);
+
+    return (ptr != NULL) ? ptr : __real_calloc(nmemb, size);
+}
+
+void *__wrap_memalign(size_t align, size_t size)
+{
+    void *ptr = arena_alloc((align > ARENA_ALIGN) ? align : ARENA_ALIGN, size);
+
+    return (ptr != NULL) ? ptr : __real_memalign(align, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    if (find_arena(ptr) == NULL)
+        return __real_realloc(ptr, size);
+
+    size_t old_size = arena_alloc_size(ptr);
+    if (size <= old_size)
+        return ptr;
+
+    // Copy only the old allocation, as what follows it belongs to others.
+    void *new_ptr = __wrap_malloc(size);
+    if (new_ptr == NULL)
+        return NULL;
+
+    memmove(new_ptr, ptr, old_size);
+
+    return new_ptr;
+}
+
+void __wrap_free(void *ptr)
+{
+    // Arena memory is released with the arena.
+    if (ptr == NULL || find_arena(ptr) != NULL)
+        return;
+
+    __real_free(ptr);
+}
@@ -0,0 +1,173 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides an index from compatible string to driver, used when
+ * binding devices to the nodes of the device tree. U-Boot's lists_bind_fdt
+ * compares each of a node's compatible strings against the match table of
+ * every driver in turn; calls to it are instead directed here (through the
+ * linker's --wrap option) where each compatible string is looked up in a
+ * hash table built from the drivers' match tables on first use.
+ *
+ * As with lists_bind_fdt, a node's compatible strings are tried in order
+ * and, for each string, the first driver in the driver list matching it is
+ * used. Requests to bind a specific driver are passed to lists_bind_fdt.
+ *
+ * The index is shared by all contexts and freed when the last context is
+ * shut down; it is built again on next use.
+ */
+
+#include <uboot_helper.h>
+#include <dm.h>
+#include <dm/device-internal.h>
+#include <dm/lists.h>
+#include <dm/ofnode.h>
+#include <uboot_wrapper.h>
+
+#ifndef UBOOT_BIND_INDEX
+#define UBOOT_BIND_INDEX 1
+#endif
+
+struct compat_entry_t {
+    const char *compatible;
+    struct driver *driver;
+    const struct udevice_id *id;
+};
+
+// Hash table of compatible strings, with linear probing. The table has a
+// power of two number of slots, at least twice the number of strings.
+static struct compat_entry_t *compat_table;
+static unsigned long compat_mask;
+
+int __real_lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
+    struct driver *drv, bool pre_reloc_only);
+
+/* FNV-1a hash of a string. */
+static unsigned long hash_compatible(const char *compatible)
+{
+    unsigned long hash = 2166136261UL;
+
+    while (*compatible) {
+        hash ^= (unsigned char)*compatible++;
+        hash *= 16777619UL;
+    }
+
+    return hash;
+}
+
+static struct compat_entry_t *find_slot(const char *compatible)
+{
+    unsigned long slot = hash_compatible(compatible) & compat_mask;
+
+    while (compat_table[slot].compatible != NULL &&
+        strcmp(compat_table[slot].compatible, compatible) != 0)
+        slot = (slot + 1) & compat_mask;
+
+    return &compat_table[slot];
+}
+
+static int build_compat_table(void)
+{
+    struct driver *drivers = ll_entry_start(struct driver, driver);
+    const int driver_count = ll_entry_count(struct driver, driver);
+    unsigned long compat_count = 0;
+
+    for (int i = 0; i < driver_count; i++)
+        for (const struct udevice_id *id = drivers[i].of_match; id && id->compatible; id++)
+            compat_count++;
+
+    unsigned long slots = 1;
+    while (slots < 2 * compat_count)
+        slots <<= 1;
+
+    // The table is shared by all contexts, so is not allocated from the
+    // arena of the context binding devices.
+    bool arena_active = uboot_arena_suspend();
+    compat_table = calloc(slots, sizeof(*compat_table));
+    uboot_arena_resume(arena_active);
+    if (compat_table == NULL)
+        return -ENOMEM;
+    compat_mask = slots - 1;
+
+    // Add the drivers in list order, keeping only the first driver matching
+    // each compatible string.
+    for (int i = 0; i < driver_count; i++) {
+        for (const struct udevice_id *id = drivers[i].of_match; id && id->compatible; id++) {
+            struct compat_entry_t *entry = find_slot(id->compatible);
+            if (entry->compatible != NULL)
+                continue;
+            entry->compatible = id->compatible;
+            entry->driver = &drivers[i];
+            entry->id = id;
+        }
+    }
+
+    UBOOT_LOGD("Indexed %lu compatible strings from %i drivers", compat_count, driver_count);
+    return 0;
+}
+
+unsigned long uboot_bind_index_release(void)
+{
+    if (compat_table == NULL)
+        return 0;
+
+    unsigned long size = (compat_mask + 1) * sizeof(*compat_table);
+    free(compat_table);
+    compat_table = NULL;
+
+    return size;
+}
+
+int __wrap_lists_bind_fdt(struct udevice *parent, ofnode node, struct udevice **devp,
+    struct driver *drv, bool pre_reloc_only)
+{
+    if (!UBOOT_BIND_INDEX || drv != NULL)
+        return __real_lists_bind_fdt(parent, node, devp, drv, pre_reloc_only);
+
+    if (compat_table == NULL && build_compat_table() != 0)
+        return __real_lists_bind_fdt(parent, node, devp, drv, pre_reloc_only);
+
+    if (devp)
+        *devp = NULL;
+
+    const char *name = ofnode_get_name(node);
+    int compat_length;
+    const char *compat_list = ofnode_get_property(node, "compatible", &compat_length);
+    if (!compat_list) {
+        if (compat_length == -FDT_ERR_NOTFOUND)
+            return 0;
+        dm_warn("Device tree error at node '%s'\n", name);
+        return compat_length;
+    }
+
+    // Try each compatible string in order of priority, first to last.
+    const char *compat;
+    for (int i = 0; i < compat_length; i += strlen(compat) + 1) {
+        compat = compat_list + i;
+
+        struct compat_entry_t *entry = find_slot(compat);
+        if (entry->compatible == NULL)
+            continue;
+
+        if (pre_reloc_only && !ofnode_pre_reloc(node) &&
+            !(entry->driver->flags & DM_FLAG_PRE_RELOC))
+            return 0;
+
+        struct udevice *dev;
+        int ret = device_bind_with_driver_data(parent, entry->driver, name,
+            entry->id->data, node, &dev);
+        if (ret == -ENODEV)
+            continue;
+        if (ret) {
+            dm_warn("Error binding driver '%s': %d\n", entry->driver->name, ret);
+            return ret;
+        }
+
+        if (devp)
+            *devp = dev;
+        break;
+    }
+
+    return 0;
+}
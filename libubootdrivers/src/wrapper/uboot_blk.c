@@ -0,0 +1,383 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides direct access to block devices registered with U-Boot's
+ * blk uclass. Reads and writes are passed straight to the block device
+ * rather than through the U-Boot command line, avoiding the command parsing,
+ * environment lookups, partition probing and console logging incurred by
+ * the equivalent run_uboot_command calls.
+ *
+ * Requests may also be queued against a handle and issued as a batch. Queued
+ * requests are sorted by block address and adjacent requests in the same
+ * direction are merged so that they are issued as a single multi-block
+ * command, with completions reported through a callback, a completion queue
+ * and optionally a Microkit notification.
+ */
+
+#include <uboot_helper.h>
+#include <blk.h>
+#include <uboot_wrapper.h>
+#include <uboot_drivers.h>
+
+// The maximum number of block devices that may be open at once.
+#define MAX_BLK_HANDLES 8
+
+// The maximum number of requests that may be queued against a handle.
+#define MAX_BLK_QUEUE_DEPTH 32
+
+// The maximum size (in bytes) of a merged request. Merged requests whose
+// buffers are not contiguous in memory are staged through a buffer of
+// this size.
+#define BLK_QUEUE_MERGE_BYTES (64 * 1024)
+
+// No Microkit channel to notify on completion.
+#define BLK_NO_NOTIFY_CHANNEL -1
+
+struct blk_queue_t {
+    // Requests submitted but not yet issued, in submission order.
+    struct uboot_blk_request requests[MAX_BLK_QUEUE_DEPTH];
+    int request_count;
+    // Completions not yet collected through uboot_blk_complete.
+    struct uboot_blk_completion completions[MAX_BLK_QUEUE_DEPTH];
+    int completion_count;
+    // Channel to notify when a batch completes.
+    int notify_channel;
+};
+
+// Block devices currently open, indexed by handle. NULL if not in use.
+static struct blk_desc *blk_handles[MAX_BLK_HANDLES];
+
+// Context through which each handle was opened.
+static struct uboot_ctx *blk_owners[MAX_BLK_HANDLES];
+
+// Request queues, indexed by handle.
+static struct blk_queue_t blk_queues[MAX_BLK_HANDLES];
+
+// Buffer used to stage merged requests, allocated on first use.
+static char *merge_buffer;
+
+static struct blk_desc *handle_to_desc(int handle)
+{
+    if (!uboot_wrapper_is_initialised())
+        return NULL;
+
+    if (handle < 0 || handle >= MAX_BLK_HANDLES)
+        return NULL;
+
+    // The device belongs to the driver model of the context that opened it.
+    if (blk_owners[handle] != uboot_wrapper_get_ctx())
+        return NULL;
+
+    return blk_handles[handle];
+}
+
+int uboot_blk_open(const char *if_typename, int devnum)
+{
+    // Return immediately if library not initialised.
+    if (!uboot_wrapper_is_initialised())
+        return -1;
+
+    int handle;
+    for (handle = 0; handle < MAX_BLK_HANDLES; handle++)
+        if (blk_handles[handle] == NULL)
+            break;
+
+    if (handle == MAX_BLK_HANDLES) {
+        UBOOT_LOGE("No free block device handles");
+        return -ENFILE;
+    }
+
+    // Probe the MMC devices on first use in lazy mode.
+    if (!strcmp(if_typename, "mmc")) {
+        int ret = uboot_wrapper_ensure_mmc();
+        if (ret)
+            return ret;
+    }
+
+    // Find and probe the device. Probing an MMC block device also performs
+    // initialisation of the card.
+    struct blk_desc *desc = blk_get_devnum_by_typename(if_typename, devnum);
+    if (desc == NULL || desc->type == DEV_TYPE_UNKNOWN) {
+        UBOOT_LOGE("No block device %s %i", if_typename, devnum);
+        return -ENODEV;
+    }
+
+    blk_handles[handle] = desc;
+    blk_owners[handle] = uboot_wrapper_get_ctx();
+    blk_queues[handle].request_count = 0;
+    blk_queues[handle].completion_count = 0;
+    blk_queues[handle].notify_channel = BLK_NO_NOTIFY_CHANNEL;
+    return handle;
+}
+
+int uboot_blk_read(int handle, unsigned long lba, unsigned long count, void *buffer)
+{
+    struct blk_desc *desc = handle_to_desc(handle);
+    if (desc == NULL)
+        return -EBADF;
+
+    if (blk_dread(desc, lba, count, buffer) != count)
+        return -EIO;
+
+    return 0;
+}
+
+int uboot_blk_write(int handle, unsigned long lba, unsigned long count, const void *buffer)
+{
+    struct blk_desc *desc = handle_to_desc(handle);
+    if (desc == NULL)
+        return -EBADF;
+
+    if (blk_dwrite(desc, lba, count, buffer) != count)
+        return -EIO;
+
+    return 0;
+}
+
+int uboot_blk_info(int handle, struct uboot_blk_info *info)
+{
+    struct blk_desc *desc = handle_to_desc(handle);
+    if (desc == NULL)
+        return -EBADF;
+
+    info->block_size = desc->blksz;
+    info->block_count = desc->lba;
+
+    return 0;
+}
+
+int uboot_blk_sync(int handle)
+{
+    struct blk_desc *desc = handle_to_desc(handle);
+    if (desc == NULL)
+        return -EBADF;
+
+    if (uboot_blk_cache_flush(desc->bdev))
+        return -EIO;
+
+    return 0;
+}
+
+void uboot_blk_close(int handle)
+{
+    if (handle_to_desc(handle) == NULL)
+        return;
+
+    // Complete any outstanding requests before the handle is released.
+    uboot_blk_process(handle);
+
+    blk_handles[handle] = NULL;
+    blk_owners[handle] = NULL;
+}
+
+void uboot_blk_close_all(struct uboot_ctx *ctx)
+{
+    for (int handle = 0; handle < MAX_BLK_HANDLES; handle++)
+        if (blk_handles[handle] != NULL && blk_owners[handle] == ctx)
+            uboot_blk_close(handle);
+}
+
+int uboot_blk_submit(int handle, const struct uboot_blk_request *request)
+{
+    struct blk_desc *desc = handle_to_desc(handle);
+    if (desc == NULL)
+        return -EBADF;
+
+    struct blk_queue_t *queue = &blk_queues[handle];
+
+    // Requests can only be accepted while there is room for both the
+    // request and its eventual completion.
+    if (queue->request_count + queue->completion_count >= MAX_BLK_QUEUE_DEPTH)
+        return -EAGAIN;
+
+    queue->requests[queue->request_count++] = *request;
+    return 0;
+}
+
+void uboot_blk_set_notify(int handle, int channel)
+{
+    if (handle_to_desc(handle) == NULL)
+        return;
+
+    blk_queues[handle].notify_channel = channel;
+}
+
+static bool requests_overlap(const struct uboot_blk_request *a,
+    const struct uboot_blk_request *b)
+{
+    return a->lba < b->lba + b->count && b->lba < a->lba + a->count;
+}
+
+/* Sort the queued requests by block address. Reordering is only safe if no
+ * write overlaps another request, otherwise the batch is issued in
+ * submission order. Returns the order to issue requests in through 'order'.
+ */
+static void order_requests(struct blk_queue_t *queue, int *order)
+{
+    bool reorder = true;
+
+    for (int i = 0; i < queue->request_count; i++) {
+        order[i] = i;
+        for (int j = 0; j < i; j++)
+            if ((queue->requests[i].write || queue->requests[j].write) &&
+                requests_overlap(&queue->requests[i], &queue->requests[j]))
+                reorder = false;
+    }
+
+    if (!reorder)
+        return;
+
+    // Insertion sort; the queue is short and usually close to sorted.
+    for (int i = 1; i < queue->request_count; i++) {
+        int current = order[i];
+        int j = i - 1;
+        while (j >= 0 && queue->requests[order[j]].lba > queue->requests[current].lba) {
+            order[j + 1] = order[j];
+            j--;
+        }
+        order[j + 1] = current;
+    }
+}
+
+/* Issue a group of requests that are in the same direction and cover a
+ * contiguous range of blocks as a single multi-block command. */
+static int issue_merged(struct blk_desc *desc, struct uboot_blk_request **group,
+    int group_count)
+{
+    struct uboot_blk_request *first = group[0];
+    unsigned long lba = first->lba;
+    unsigned long count = 0;
+    bool contiguous = true;
+
+    for (int i = 0; i < group_count; i++) {
+        if ((char *)group[i]->buffer != (char *)first->buffer + count * desc->blksz)
+            contiguous = false;
+        count += group[i]->count;
+    }
+
+    // Buffers that follow on from each other in memory can be transferred
+    // in place, otherwise the data is staged through the merge buffer.
+    char *buffer = contiguous ? first->buffer : merge_buffer;
+
+    if (first->write && !contiguous) {
+        char *dest = buffer;
+        for (int i = 0; i < group_count; i++) {
+            memcpy(dest, group[i]->buffer, group[i]->count * desc->blksz);
+            dest += group[i]->count * desc->blksz;
+        }
+    }
+
+    unsigned long done = first->write ?
+        blk_dwrite(desc, lba, count, buffer) :
+        blk_dread(desc, lba, count, buffer);
+    if (done != count)
+        return -EIO;
+
+    if (!first->write && !contiguous) {
+        const char *src = buffer;
+        for (int i = 0; i < group_count; i++) {
+            memcpy(group[i]->buffer, src, group[i]->count * desc->blksz);
+            src += group[i]->count * desc->blksz;
+        }
+    }
+
+    return 0;
+}
+
+static void complete_request(struct blk_queue_t *queue,
+    const struct uboot_blk_request *request, int status)
+{
+    struct uboot_blk_completion *completion =
+        &queue->completions[queue->completion_count++];
+    completion->cookie = request->cookie;
+    completion->status = status;
+
+    if (request->callback != NULL)
+        request->callback(request->cookie, status);
+}
+
+int uboot_blk_process(int handle)
+{
+    struct blk_desc *desc = handle_to_desc(handle);
+    if (desc == NULL)
+        return -EBADF;
+
+    struct blk_queue_t *queue = &blk_queues[handle];
+    if (queue->request_count == 0)
+        return 0;
+
+    if (merge_buffer == NULL) {
+        merge_buffer = malloc(BLK_QUEUE_MERGE_BYTES);
+        if (merge_buffer == NULL)
+            return -ENOMEM;
+    }
+
+    // Completion callbacks may submit further requests while the batch is
+    // issued; these are left queued for the next batch.
+    int count = queue->request_count;
+    int order[MAX_BLK_QUEUE_DEPTH];
+    order_requests(queue, order);
+
+    unsigned long max_merge_blocks = BLK_QUEUE_MERGE_BYTES / desc->blksz;
+    int issued = 0;
+
+    for (int i = 0; i < count; ) {
+        struct uboot_blk_request *group[MAX_BLK_QUEUE_DEPTH];
+        int group_count = 0;
+        unsigned long group_blocks = 0;
+
+        // Gather the following requests that continue on from this one.
+        group[group_count++] = &queue->requests[order[i]];
+        group_blocks = group[0]->count;
+        for (i++; i < count; i++) {
+            struct uboot_blk_request *next = &queue->requests[order[i]];
+            struct uboot_blk_request *last = group[group_count - 1];
+            if (next->write != last->write ||
+                next->lba != last->lba + last->count ||
+                group_blocks + next->count > max_merge_blocks)
+                break;
+            group[group_count++] = next;
+            group_blocks += next->count;
+        }
+
+        int status = (group_count == 1) ?
+            (group[0]->write ?
+                uboot_blk_write(handle, group[0]->lba, group[0]->count, group[0]->buffer) :
+                uboot_blk_read(handle, group[0]->lba, group[0]->count, group[0]->buffer)) :
+            issue_merged(desc, group, group_count);
+
+        for (int g = 0; g < group_count; g++)
+            complete_request(queue, group[g], status);
+        issued += group_count;
+    }
+
+    // Move any requests submitted during the batch to the front of the queue.
+    memmove(queue->requests, &queue->requests[count],
+        (queue->request_count - count) * sizeof(*queue->requests));
+    queue->request_count -= count;
+
+    if (queue->notify_channel != BLK_NO_NOTIFY_CHANNEL)
+        microkit_notify(queue->notify_channel);
+
+    return issued;
+}
+
+int uboot_blk_complete(int handle, struct uboot_blk_completion *completions, int max)
+{
+    if (handle_to_desc(handle) == NULL)
+        return -EBADF;
+
+    struct blk_queue_t *queue = &blk_queues[handle];
+    int count = (queue->completion_count < max) ? queue->completion_count : max;
+
+    memcpy(completions, queue->completions, count * sizeof(*completions));
+
+    // Shuffle any completions not collected to the front of the queue.
+    memmove(queue->completions, &queue->completions[count],
+        (queue->completion_count - count) * sizeof(*completions));
+    queue->completion_count -= count;
+
+    return count;
+}
@@ -0,0 +1,785 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides a cache of MMC blocks beneath the blk uclass. File
+ * system operations repeatedly read the same partition table, FAT and
+ * directory blocks, each of which would otherwise be a command to the card.
+ *
+ * The cache is interposed by replacing the operations of the MMC block
+ * driver, so all block access (commands, file systems and the direct block
+ * API) passes through it. Blocks are cached individually, keyed by device
+ * and block address, and replaced in least recently used order.
+ *
+ * Writes are handled according to LIB_UBOOT_BLK_CACHE_WRITE_BACK:
+ *
+ * - Write-through (the default): writes are passed straight to the device,
+ *   updating any cached copies of the blocks written.
+ *
+ * - Write-back: written blocks are held in the cache as dirty and written
+ *   to the device later, sorted by block address with adjacent blocks merged
+ *   into multi-block writes. Dirty blocks are written when uboot_blk_sync
+ *   (or uboot_fs_sync / uboot_fs_close) is called, when the number of dirty
+ *   blocks reaches LIB_UBOOT_BLK_CACHE_DIRTY_BLOCKS, when the oldest dirty
+ *   block has been held for LIB_UBOOT_BLK_CACHE_FLUSH_MS (checked on each
+ *   block access) and when the library is shut down.
+ *
+ *   Durability: a write is only durable once a sync has returned
+ *   successfully; data written since the last sync is lost if power is
+ *   removed. Dirty blocks are not written in the order they were written by
+ *   the caller, so a file system interrupted between syncs may be left
+ *   inconsistent on the card.
+ *
+ * Sequential reads are detected and the blocks following them read ahead
+ * into the cache as a single multi-block transfer, so that a file read in
+ * cluster sized pieces is read from the device in larger transfers. The
+ * readahead window starts small and doubles each time it is consumed, up to
+ * LIB_UBOOT_BLK_CACHE_READAHEAD blocks.
+ *
+ * A range of blocks may also be pinned in the cache, in addition to the
+ * blocks replaced in LRU order. This is used to keep the start of a FAT
+ * partition's allocation table in memory, as the FAT driver scans the table
+ * from its start for free clusters whenever a file grows. Up to
+ * LIB_UBOOT_BLK_CACHE_PIN_BLOCKS blocks may be pinned. Memory for the pinned
+ * blocks is allocated when a range is first pinned, so is only taken by
+ * protection domains writing files through uboot_fs_open.
+ *
+ * The size of the cache is set through LIB_UBOOT_BLK_CACHE_BLOCKS in CMake;
+ * a size of 0 disables the cache.
+ */
+
+#include <uboot_helper.h>
+#include <blk.h>
+#include <dm.h>
+#include <dm/lists.h>
+#include <linux/list.h>
+#include <time.h>
+#include <uboot_wrapper.h>
+#include <uboot_drivers.h>
+
+#ifndef UBOOT_BLK_CACHE_BLOCKS
+#define UBOOT_BLK_CACHE_BLOCKS 0
+#endif
+
+#ifndef UBOOT_BLK_CACHE_WRITE_BACK
+#define UBOOT_BLK_CACHE_WRITE_BACK 0
+#endif
+
+#ifndef UBOOT_BLK_CACHE_DIRTY_BLOCKS
+#define UBOOT_BLK_CACHE_DIRTY_BLOCKS (UBOOT_BLK_CACHE_BLOCKS / 2)
+#endif
+
+#ifndef UBOOT_BLK_CACHE_FLUSH_MS
+#define UBOOT_BLK_CACHE_FLUSH_MS 1000
+#endif
+
+#ifndef UBOOT_BLK_CACHE_READAHEAD
+#define UBOOT_BLK_CACHE_READAHEAD 0
+#endif
+
+#ifndef UBOOT_BLK_CACHE_PIN_BLOCKS
+#define UBOOT_BLK_CACHE_PIN_BLOCKS 0
+#endif
+
+// The total number of blocks that may be held, pinned or otherwise.
+#define BLK_CACHE_TOTAL_BLOCKS (UBOOT_BLK_CACHE_BLOCKS + UBOOT_BLK_CACHE_PIN_BLOCKS)
+
+#if defined(CONFIG_DM_MMC) && UBOOT_BLK_CACHE_BLOCKS > 0
+
+// The size of the blocks held by the cache. Devices with other block sizes
+// are not cached.
+#define BLK_CACHE_BLOCK_SIZE 512
+
+// Reads or writes of more blocks than this are not added to the cache,
+// preventing a single large transfer from displacing the whole cache.
+#define BLK_CACHE_MAX_INSERT_BLOCKS (UBOOT_BLK_CACHE_BLOCKS / 4)
+
+// The maximum number of dirty blocks merged into a single write.
+#define BLK_CACHE_MAX_FLUSH_BLOCKS 128
+
+// The maximum number of blocks read ahead, limited so that readahead cannot
+// displace more of the cache than a single read, and the initial window.
+#define BLK_CACHE_MAX_READAHEAD \
+    (UBOOT_BLK_CACHE_READAHEAD < BLK_CACHE_MAX_INSERT_BLOCKS ? \
+        UBOOT_BLK_CACHE_READAHEAD : BLK_CACHE_MAX_INSERT_BLOCKS)
+#define BLK_CACHE_MIN_READAHEAD \
+    (BLK_CACHE_MAX_READAHEAD < 8 ? BLK_CACHE_MAX_READAHEAD : 8)
+
+// The number of sequential read streams tracked at once.
+#define BLK_CACHE_READ_STREAMS 4
+
+// The name of the block driver to cache.
+#define BLK_CACHE_DRIVER_NAME "mmc_blk"
+
+struct cache_entry_t {
+    // Position in the LRU list (most recently used first) or the free list,
+    // or in the pinned lists for pinned blocks.
+    struct list_head list;
+    // Next entry in the same hash bucket.
+    struct cache_entry_t *hash_next;
+    struct udevice *dev;
+    lbaint_t lba;
+    // Set if the block has been written but not yet written to the device.
+    bool dirty;
+    // Set if the block is within the pinned range and never evicted.
+    bool pinned;
+    char *data;
+};
+
+struct read_stream_t {
+    struct udevice *dev;
+    // The block a sequential read would continue from.
+    lbaint_t next;
+    // The number of blocks to read ahead on the next readahead.
+    lbaint_t window;
+    // Incremented on each read, used to replace the least recently used.
+    unsigned long last_used;
+};
+
+static struct cache_entry_t *cache_entries;
+static char *cache_data;
+static struct list_head lru_list;
+static struct list_head free_list;
+
+// Entries for blocks within the pinned range, held separately from the LRU
+// list so that they are never evicted.
+static struct list_head pinned_list;
+static struct list_head pinned_free_list;
+static char *pin_data;
+static struct udevice *pin_dev;
+static lbaint_t pin_start;
+static lbaint_t pin_count;
+
+static struct cache_entry_t **hash_table;
+static unsigned long hash_mask;
+
+// Dirty block tracking for write-back. 'dirty_since' holds the time (in
+// microseconds) the oldest dirty block was written.
+static unsigned long dirty_count;
+static uint64_t dirty_since;
+
+// Buffer used to merge adjacent dirty blocks into a single write, and the
+// array used to sort dirty blocks into the order they are written.
+static char *flush_buffer;
+static struct cache_entry_t **flush_order;
+
+// Set while dirty blocks are written back. Drivers may select the hardware
+// partition from within a write, which must not start another flush.
+static bool flushing;
+
+// Sequential read detection and the buffer blocks are read ahead into.
+static struct read_stream_t read_streams[BLK_CACHE_READ_STREAMS];
+static unsigned long read_count;
+static char *readahead_buffer;
+
+// The driver whose operations are replaced, and its original operations.
+static struct driver *cached_driver;
+static const struct blk_ops *device_ops;
+static struct blk_ops cached_ops;
+
+static struct uboot_blk_cache_stats cache_stats;
+
+static int flush_dirty_blocks(struct udevice *dev);
+
+static unsigned long hash_block(struct udevice *dev, lbaint_t lba)
+{
+    return ((unsigned long)lba ^ ((uintptr_t)dev >> 4)) & hash_mask;
+}
+
+static struct cache_entry_t *lookup_block(struct udevice *dev, lbaint_t lba)
+{
+    struct cache_entry_t *entry = hash_table[hash_block(dev, lba)];
+
+    while (entry != NULL && (entry->dev != dev || entry->lba != lba))
+        entry = entry->hash_next;
+
+    return entry;
+}
+
+static void mark_clean(struct cache_entry_t *entry)
+{
+    if (entry->dirty) {
+        entry->dirty = false;
+        dirty_count--;
+    }
+}
+
+static void mark_dirty(struct cache_entry_t *entry)
+{
+    if (!entry->dirty) {
+        if (dirty_count == 0)
+            dirty_since = timer_get_us();
+        entry->dirty = true;
+        dirty_count++;
+    }
+}
+
+/* Remove a block from the cache. Any unwritten data is discarded. */
+static void remove_block(struct cache_entry_t *entry)
+{
+    struct cache_entry_t **link = &hash_table[hash_block(entry->dev, entry->lba)];
+
+    while (*link != entry)
+        link = &(*link)->hash_next;
+    *link = entry->hash_next;
+
+    mark_clean(entry);
+    entry->dev = NULL;
+    if (entry->pinned) {
+        list_move(&entry->list, &pinned_free_list);
+        cache_stats.blocks_pinned--;
+    } else {
+        list_move(&entry->list, &free_list);
+        cache_stats.blocks_cached--;
+    }
+}
+
+/* Mark a block as the most recently used. */
+static void touch_block(struct cache_entry_t *entry)
+{
+    if (!entry->pinned)
+        list_move(&entry->list, &lru_list);
+}
+
+static bool is_pinned_block(struct udevice *dev, lbaint_t lba)
+{
+    return dev == pin_dev && lba >= pin_start && lba - pin_start < pin_count;
+}
+
+/* Find the least recently used block that can be evicted without loss. */
+static struct cache_entry_t *find_victim(void)
+{
+    struct cache_entry_t *entry;
+
+    list_for_each_entry_reverse(entry, &lru_list, list)
+        if (!entry->dirty)
+            return entry;
+
+    return NULL;
+}
+
+/* Add a block to the cache (or update the cached copy), returning its entry
+ * or NULL if no entry could be freed for it. */
+static struct cache_entry_t *insert_block(struct udevice *dev, lbaint_t lba,
+    const void *data)
+{
+    struct cache_entry_t *entry = lookup_block(dev, lba);
+
+    if (entry == NULL && is_pinned_block(dev, lba) && !list_empty(&pinned_free_list)) {
+        entry = list_first_entry(&pinned_free_list, struct cache_entry_t, list);
+        entry->pinned = true;
+        list_move(&entry->list, &pinned_list);
+        cache_stats.blocks_pinned++;
+    } else if (entry == NULL) {
+        // Use a free entry, otherwise evict the least recently used clean
+        // block, writing dirty blocks to the device if all are dirty.
+        if (list_empty(&free_list)) {
+            struct cache_entry_t *victim = find_victim();
+            if (victim == NULL && flush_dirty_blocks(NULL) == 0)
+                victim = find_victim();
+            if (victim == NULL)
+                return NULL;
+
+            remove_block(victim);
+            cache_stats.evictions++;
+        }
+        entry = list_first_entry(&free_list, struct cache_entry_t, list);
+        entry->pinned = false;
+        cache_stats.blocks_cached++;
+    }
+
+    if (entry->dev == NULL) {
+        unsigned long bucket = hash_block(dev, lba);
+        entry->dev = dev;
+        entry->lba = lba;
+        entry->dirty = false;
+        entry->hash_next = hash_table[bucket];
+        hash_table[bucket] = entry;
+    }
+
+    memcpy(entry->data, data, BLK_CACHE_BLOCK_SIZE);
+    touch_block(entry);
+
+    return entry;
+}
+
+static void invalidate_list(struct list_head *list, struct udevice *dev,
+    lbaint_t start, lbaint_t blkcnt)
+{
+    struct cache_entry_t *entry, *next;
+
+    list_for_each_entry_safe(entry, next, list, list)
+        if ((dev == NULL || entry->dev == dev) &&
+            entry->lba >= start && entry->lba - start < blkcnt)
+            remove_block(entry);
+}
+
+/* Remove a range of blocks of the given device (or all devices if NULL)
+ * from the cache. Any unwritten data is discarded. */
+static void invalidate_blocks(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
+{
+    invalidate_list(&lru_list, dev, start, blkcnt);
+    invalidate_list(&pinned_list, dev, start, blkcnt);
+}
+
+static bool entry_before(const struct cache_entry_t *a, const struct cache_entry_t *b)
+{
+    if (a->dev != b->dev)
+        return (uintptr_t)a->dev < (uintptr_t)b->dev;
+
+    return a->lba < b->lba;
+}
+
+/* Add the dirty blocks in a list to flush_order, keeping it sorted. */
+static void gather_dirty_blocks(struct list_head *list, struct udevice *dev,
+    unsigned long *count)
+{
+    struct cache_entry_t *entry;
+
+    list_for_each_entry(entry, list, list) {
+        if (!entry->dirty || (dev != NULL && entry->dev != dev))
+            continue;
+
+        unsigned long i = (*count)++;
+        while (i > 0 && entry_before(entry, flush_order[i - 1])) {
+            flush_order[i] = flush_order[i - 1];
+            i--;
+        }
+        flush_order[i] = entry;
+    }
+}
+
+/* Write dirty blocks (of the given device, or all devices if NULL) to the
+ * device in block address order, merging adjacent blocks into a single
+ * write. Returns 0 if all were written. */
+static int flush_dirty_blocks(struct udevice *dev)
+{
+    if (dirty_count == 0 || flushing)
+        return 0;
+
+    flushing = true;
+
+    struct cache_entry_t **dirty = flush_order;
+    unsigned long count = 0;
+
+    // Gather the dirty blocks, sorted by device and block address.
+    gather_dirty_blocks(&lru_list, dev, &count);
+    gather_dirty_blocks(&pinned_list, dev, &count);
+
+    int ret = 0;
+
+    for (unsigned long i = 0; i < count; ) {
+        // Gather the run of blocks following on from this one.
+        unsigned long run = 1;
+        while (i + run < count && run < BLK_CACHE_MAX_FLUSH_BLOCKS &&
+               dirty[i + run]->dev == dirty[i]->dev &&
+               dirty[i + run]->lba == dirty[i]->lba + run)
+            run++;
+
+        for (unsigned long j = 0; j < run; j++)
+            memcpy(flush_buffer + j * BLK_CACHE_BLOCK_SIZE, dirty[i + j]->data,
+                BLK_CACHE_BLOCK_SIZE);
+
+        if (device_ops->write(dirty[i]->dev, dirty[i]->lba, run, flush_buffer) == run) {
+            for (unsigned long j = 0; j < run; j++)
+                mark_clean(dirty[i + j]);
+            cache_stats.flushes++;
+        } else {
+            UBOOT_LOGE("Failed to write back %lu blocks at " LBAF, run, dirty[i]->lba);
+            ret = -EIO;
+        }
+
+        i += run;
+    }
+
+    // Restart the timer for any blocks that remain dirty.
+    if (dirty_count > 0)
+        dirty_since = timer_get_us();
+
+    flushing = false;
+
+    return ret;
+}
+
+/* Write dirty blocks to the device if they have been held for too long. */
+static void check_flush_timer(void)
+{
+    if (dirty_count > 0 &&
+        timer_get_us() - dirty_since >= UBOOT_BLK_CACHE_FLUSH_MS * 1000ULL)
+        flush_dirty_blocks(NULL);
+}
+
+static bool is_cacheable(struct udevice *dev)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+
+    return desc->blksz == BLK_CACHE_BLOCK_SIZE;
+}
+
+/* Record a read, returning its stream if it continues a sequential read or
+ * NULL otherwise. */
+static struct read_stream_t *track_read(struct udevice *dev, lbaint_t start,
+    lbaint_t blkcnt)
+{
+    struct read_stream_t *stream = NULL;
+    struct read_stream_t *oldest = &read_streams[0];
+
+    for (int i = 0; i < BLK_CACHE_READ_STREAMS; i++) {
+        if (read_streams[i].dev == dev && read_streams[i].next == start)
+            stream = &read_streams[i];
+        if (read_streams[i].last_used < oldest->last_used)
+            oldest = &read_streams[i];
+    }
+
+    bool sequential = (stream != NULL);
+    if (!sequential) {
+        // Start tracking a new stream in place of the least recently used.
+        stream = oldest;
+        stream->dev = dev;
+        stream->window = BLK_CACHE_MIN_READAHEAD;
+    }
+
+    stream->next = start + blkcnt;
+    stream->last_used = ++read_count;
+
+    return sequential ? stream : NULL;
+}
+
+/* Read the blocks following a sequential read into the cache, unless they
+ * are already cached. */
+static void read_ahead(struct udevice *dev, struct read_stream_t *stream)
+{
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    lbaint_t start = stream->next;
+
+    if (start >= desc->lba || lookup_block(dev, start) != NULL)
+        return;
+
+    // Read the run of uncached blocks within the window.
+    lbaint_t count = min_t(lbaint_t, stream->window, desc->lba - start);
+    lbaint_t run = 1;
+    while (run < count && lookup_block(dev, start + run) == NULL)
+        run++;
+
+    if (device_ops->read(dev, start, run, readahead_buffer) != run)
+        return;
+
+    for (lbaint_t i = 0; i < run; i++)
+        insert_block(dev, start + i, readahead_buffer + i * BLK_CACHE_BLOCK_SIZE);
+    cache_stats.readahead += run;
+
+    // Grow the window for the next readahead.
+    stream->window = min_t(lbaint_t, stream->window * 2, BLK_CACHE_MAX_READAHEAD);
+}
+
+static ulong cached_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+    void *buffer)
+{
+    if (!is_cacheable(dev))
+        return device_ops->read(dev, start, blkcnt, buffer);
+
+    check_flush_timer();
+
+    char *dest = buffer;
+    lbaint_t i = 0;
+
+    while (i < blkcnt) {
+        struct cache_entry_t *entry = lookup_block(dev, start + i);
+        if (entry != NULL) {
+            memcpy(dest + i * BLK_CACHE_BLOCK_SIZE, entry->data, BLK_CACHE_BLOCK_SIZE);
+            touch_block(entry);
+            cache_stats.hits++;
+            i++;
+            continue;
+        }
+
+        // Read the run of blocks missing from the cache as a single request.
+        lbaint_t run = 1;
+        while (i + run < blkcnt && lookup_block(dev, start + i + run) == NULL)
+            run++;
+
+        ulong done = device_ops->read(dev, start + i, run, dest + i * BLK_CACHE_BLOCK_SIZE);
+        cache_stats.misses += run;
+        if (done != run)
+            return i + done;
+
+        if (run <= BLK_CACHE_MAX_INSERT_BLOCKS)
+            for (lbaint_t j = 0; j < run; j++)
+                insert_block(dev, start + i + j, dest + (i + j) * BLK_CACHE_BLOCK_SIZE);
+
+        i += run;
+    }
+
+    // Read ahead if this continues a sequential read. Reads too large to be
+    // cached already make efficient use of the device.
+    if (BLK_CACHE_MAX_READAHEAD > 0 && blkcnt <= BLK_CACHE_MAX_INSERT_BLOCKS) {
+        struct read_stream_t *stream = track_read(dev, start, blkcnt);
+        if (stream != NULL)
+            read_ahead(dev, stream);
+    }
+
+    return blkcnt;
+}
+
+static ulong write_through(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+    const void *buffer)
+{
+    ulong done = device_ops->write(dev, start, blkcnt, buffer);
+
+    // Keep cached copies of the written blocks up to date. These now match
+    // the device, superseding any earlier unwritten data.
+    const char *src = buffer;
+    for (lbaint_t i = 0; i < done; i++) {
+        struct cache_entry_t *entry = lookup_block(dev, start + i);
+        if (entry != NULL) {
+            memcpy(entry->data, src + i * BLK_CACHE_BLOCK_SIZE, BLK_CACHE_BLOCK_SIZE);
+            mark_clean(entry);
+        }
+    }
+
+    // Discard cached copies of any blocks that failed to write.
+    if (done != blkcnt)
+        invalidate_blocks(dev, start + done, blkcnt - done);
+
+    return done;
+}
+
+static ulong cached_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+    const void *buffer)
+{
+    if (!is_cacheable(dev))
+        return device_ops->write(dev, start, blkcnt, buffer);
+
+    if (!UBOOT_BLK_CACHE_WRITE_BACK || blkcnt > BLK_CACHE_MAX_INSERT_BLOCKS)
+        return write_through(dev, start, blkcnt, buffer);
+
+    // Hold the blocks in the cache to be written back later.
+    const char *src = buffer;
+    for (lbaint_t i = 0; i < blkcnt; i++) {
+        struct cache_entry_t *entry = insert_block(dev, start + i,
+            src + i * BLK_CACHE_BLOCK_SIZE);
+        if (entry == NULL) {
+            // No room in the cache; write the remaining blocks directly.
+            return i + write_through(dev, start + i, blkcnt - i,
+                src + i * BLK_CACHE_BLOCK_SIZE);
+        }
+        mark_dirty(entry);
+    }
+
+    if (dirty_count >= UBOOT_BLK_CACHE_DIRTY_BLOCKS)
+        flush_dirty_blocks(NULL);
+    else
+        check_flush_timer();
+
+    return blkcnt;
+}
+
+static ulong cached_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
+{
+    // Erased blocks supersede any unwritten data.
+    invalidate_blocks(dev, start, blkcnt);
+
+    return device_ops->erase(dev, start, blkcnt);
+}
+
+static int cached_select_hwpart(struct udevice *dev, int hwpart)
+{
+    // Drivers select the hardware partition before every transfer, so the
+    // cache is only affected by a switch to a different partition.
+    struct blk_desc *desc = dev_get_uclass_plat(dev);
+    if (desc->hwpart == hwpart)
+        return device_ops->select_hwpart(dev, hwpart);
+
+    // Block addresses refer to a different hardware partition once switched,
+    // so unwritten data must reach the current partition first.
+    int ret = flush_dirty_blocks(dev);
+    if (ret)
+        return ret;
+    invalidate_blocks(dev, 0, (lbaint_t)-1);
+
+    return device_ops->select_hwpart(dev, hwpart);
+}
+
+int uboot_blk_cache_init(void)
+{
+    // Already interposed; interposing again would take the cache's own
+    // operations as the driver's.
+    if (device_ops != NULL)
+        return 0;
+
+    cached_driver = lists_driver_lookup_name(BLK_CACHE_DRIVER_NAME);
+    if (cached_driver == NULL)
+        return 0;
+
+    cache_entries = calloc(BLK_CACHE_TOTAL_BLOCKS, sizeof(*cache_entries));
+    cache_data = malloc(UBOOT_BLK_CACHE_BLOCKS * BLK_CACHE_BLOCK_SIZE);
+    flush_buffer = malloc(BLK_CACHE_MAX_FLUSH_BLOCKS * BLK_CACHE_BLOCK_SIZE);
+    flush_order = calloc(BLK_CACHE_TOTAL_BLOCKS, sizeof(*flush_order));
+    readahead_buffer = malloc((BLK_CACHE_MAX_READAHEAD + 1) * BLK_CACHE_BLOCK_SIZE);
+
+    // Size the hash table to the next power of two at or above the number
+    // of blocks cached.
+    unsigned long buckets = 1;
+    while (buckets < BLK_CACHE_TOTAL_BLOCKS)
+        buckets <<= 1;
+    hash_mask = buckets - 1;
+    hash_table = calloc(buckets, sizeof(*hash_table));
+
+    if (cache_entries == NULL || cache_data == NULL || flush_buffer == NULL ||
+        flush_order == NULL || readahead_buffer == NULL || hash_table == NULL) {
+        uboot_blk_cache_shutdown();
+        return -ENOMEM;
+    }
+
+    INIT_LIST_HEAD(&lru_list);
+    INIT_LIST_HEAD(&free_list);
+    INIT_LIST_HEAD(&pinned_list);
+    INIT_LIST_HEAD(&pinned_free_list);
+    for (int i = 0; i < UBOOT_BLK_CACHE_BLOCKS; i++) {
+        cache_entries[i].data = cache_data + i * BLK_CACHE_BLOCK_SIZE;
+        list_add_tail(&cache_entries[i].list, &free_list);
+    }
+    // The entries of the pinned range are given memory when first pinned.
+    for (int i = UBOOT_BLK_CACHE_BLOCKS; i < BLK_CACHE_TOTAL_BLOCKS; i++)
+        list_add_tail(&cache_entries[i].list, &pinned_free_list);
+    pin_dev = NULL;
+    pin_count = 0;
+
+    dirty_count = 0;
+    memset(read_streams, 0, sizeof(read_streams));
+    read_count = 0;
+    memset(&cache_stats, 0, sizeof(cache_stats));
+    cache_stats.blocks_max = UBOOT_BLK_CACHE_BLOCKS;
+    cache_stats.blocks_pinned_max = UBOOT_BLK_CACHE_PIN_BLOCKS;
+
+    // Interpose on the driver's operations.
+    device_ops = cached_driver->ops;
+    cached_ops = *device_ops;
+    cached_ops.read = cached_read;
+    if (device_ops->write)
+        cached_ops.write = cached_write;
+    if (device_ops->erase)
+        cached_ops.erase = cached_erase;
+    if (device_ops->select_hwpart)
+        cached_ops.select_hwpart = cached_select_hwpart;
+    cached_driver->ops = &cached_ops;
+
+    return 0;
+}
+
+void uboot_blk_cache_shutdown(void)
+{
+    // Write back any unwritten data, then restore the driver's original
+    // operations.
+    if (cached_driver != NULL && device_ops != NULL) {
+        flush_dirty_blocks(NULL);
+        cached_driver->ops = device_ops;
+    }
+    cached_driver = NULL;
+    device_ops = NULL;
+
+    free(cache_entries);
+    free(cache_data);
+    free(pin_data);
+    free(flush_buffer);
+    free(flush_order);
+    free(readahead_buffer);
+    free(hash_table);
+    cache_entries = NULL;
+    cache_data = NULL;
+    pin_data = NULL;
+    flush_buffer = NULL;
+    flush_order = NULL;
+    readahead_buffer = NULL;
+    hash_table = NULL;
+}
+
+int uboot_blk_cache_flush(struct udevice *dev)
+{
+    if (device_ops == NULL)
+        return 0;
+
+    return flush_dirty_blocks(dev);
+}
+
+int uboot_blk_cache_pin(struct udevice *dev, unsigned long start, unsigned long blkcnt)
+{
+    if (device_ops == NULL || UBOOT_BLK_CACHE_PIN_BLOCKS == 0)
+        return 0;
+
+    blkcnt = min_t(unsigned long, blkcnt, UBOOT_BLK_CACHE_PIN_BLOCKS);
+    if (dev == pin_dev && start == pin_start && blkcnt == pin_count)
+        return 0;
+
+    if (pin_data == NULL) {
+        pin_data = malloc(UBOOT_BLK_CACHE_PIN_BLOCKS * BLK_CACHE_BLOCK_SIZE);
+        if (pin_data == NULL)
+            return -ENOMEM;
+        for (int i = 0; i < UBOOT_BLK_CACHE_PIN_BLOCKS; i++)
+            cache_entries[UBOOT_BLK_CACHE_BLOCKS + i].data = pin_data + i * BLK_CACHE_BLOCK_SIZE;
+    }
+
+    // Write back any unwritten data, then release the blocks pinned
+    // previously. Blocks of the new range already in the LRU list are
+    // discarded, to be pinned as they are next read.
+    int ret = flush_dirty_blocks(NULL);
+    if (ret)
+        return ret;
+    invalidate_list(&pinned_list, NULL, 0, (lbaint_t)-1);
+    invalidate_list(&lru_list, dev, start, blkcnt);
+
+    pin_dev = dev;
+    pin_start = start;
+    pin_count = blkcnt;
+
+    return 0;
+}
+
+int uboot_blk_cache_get_stats(struct uboot_blk_cache_stats *stats)
+{
+    if (!uboot_wrapper_is_initialised() || device_ops == NULL)
+        return -ENODEV;
+
+    *stats = cache_stats;
+    stats->blocks_dirty = dirty_count;
+    return 0;
+}
+
+void uboot_blk_cache_invalidate(void)
+{
+    if (device_ops == NULL)
+        return;
+
+    // Write back any unwritten data so that it is not lost.
+    flush_dirty_blocks(NULL);
+
+    invalidate_blocks(NULL, 0, (lbaint_t)-1);
+}
+
+void uboot_blk_cache_purge(void)
+{
+    if (device_ops == NULL)
+        return;
+
+    flush_dirty_blocks(NULL);
+    invalidate_blocks(NULL, 0, (lbaint_t)-1);
+
+    // Forget the read streams and pinned range, whose devices may be
+    // released.
+    memset(read_streams, 0, sizeof(read_streams));
+    pin_dev = NULL;
+    pin_count = 0;
+}
+
+#else
+
+int uboot_blk_cache_init(void) { return 0; }
+void uboot_blk_cache_shutdown(void) {}
+int uboot_blk_cache_flush(struct udevice *dev) { return 0; }
+int uboot_blk_cache_pin(struct udevice *dev, unsigned long start, unsigned long blkcnt) { return 0; }
+int uboot_blk_cache_get_stats(struct uboot_blk_cache_stats *stats) { return -ENODEV; }
+void uboot_blk_cache_invalidate(void) {}
+void uboot_blk_cache_purge(void) {}
+
+#endif
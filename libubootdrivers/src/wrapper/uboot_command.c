@@ -0,0 +1,300 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides prepared commands for commands that are run repeatedly
+ * with different arguments. Preparing a command splits its format string
+ * into arguments and resolves the command table entry once. Running the
+ * prepared command then only formats the variable arguments before calling
+ * the command directly, bypassing the command line parser, environment
+ * variable expansion and the command table search made by run_uboot_command.
+ *
+ * Commands are found through a perfect hash of the platform's command names,
+ * generated with the linker lists by scripts/gen_driver_lists.py, rather
+ * than U-Boot's search of the command table. Commands run through
+ * run_uboot_command that need none of the command line parser's features
+ * are also split and called directly from here.
+ */
+
+#include <uboot_helper.h>
+#include <command.h>
+#include <uboot_wrapper.h>
+#include <uboot_drivers.h>
+
+// The maximum number of commands that may be prepared at once.
+#define MAX_PREPARED_COMMANDS 16
+
+// The maximum length of a command format string, including the terminating
+// null, and the maximum number of arguments (including the command name).
+#define MAX_COMMAND_LENGTH 256
+#define MAX_COMMAND_ARGS 16
+
+// The maximum length of a formatted numeric argument.
+#define MAX_ARG_LENGTH 24
+
+// Characters requiring the command line parser: environment variable
+// expansion, command separators, quoting and escapes.
+#define PARSER_CHARACTERS "$;'\"\\"
+
+// Perfect hash of the command names, generated by gen_driver_lists.py.
+extern const unsigned int uboot_command_hash_seed;
+extern const unsigned int uboot_command_hash_mask;
+extern struct cmd_tbl *const uboot_command_hash_table[];
+
+enum arg_type_t {
+    ARG_FIXED,
+    ARG_STRING,         // %s
+    ARG_INT,            // %d or %i
+    ARG_UINT,           // %u
+    ARG_HEX,            // %x
+    ARG_ULONG,          // %lu
+    ARG_HEX_ULONG,      // %lx
+    ARG_POINTER,        // %p
+};
+
+struct prepared_command_t {
+    struct cmd_tbl *cmdtp;
+    int argc;
+    // The arguments; fixed arguments point into 'format', variable arguments
+    // are replaced on each run.
+    char *argv[MAX_COMMAND_ARGS + 1];
+    enum arg_type_t types[MAX_COMMAND_ARGS];
+    char format[MAX_COMMAND_LENGTH];
+};
+
+static struct prepared_command_t *prepared_commands[MAX_PREPARED_COMMANDS];
+
+/* FNV-1a hash of a command name. Must match hash_name() in
+ * gen_driver_lists.py. */
+static unsigned int hash_command_name(const char *name)
+{
+    unsigned int hash = uboot_command_hash_seed;
+
+    while (*name) {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619U;
+    }
+
+    return hash ^ (hash >> 16);
+}
+
+struct cmd_tbl *uboot_command_find(const char *name)
+{
+    struct cmd_tbl *cmdtp =
+        uboot_command_hash_table[hash_command_name(name) & uboot_command_hash_mask];
+
+    if (cmdtp != NULL && !strcmp(cmdtp->name, name))
+        return cmdtp;
+
+    // Not a full command name; U-Boot also accepts unique abbreviations and
+    // size suffixes (e.g. 'md.b').
+    return find_cmd(name);
+}
+
+int uboot_command_run_direct(const char *cmd, int flag)
+{
+    char line[CONFIG_SYS_CBSIZE];
+    char *argv[CONFIG_SYS_MAXARGS + 1];
+    int argc = 0;
+
+    if (strlen(cmd) >= sizeof(line) || strpbrk(cmd, PARSER_CHARACTERS) != NULL)
+        return -EAGAIN;
+
+    // Split the command into arguments in place, as the parser would.
+    strcpy(line, cmd);
+    char *next = line;
+    char *arg;
+    while ((arg = strsep(&next, " \t")) != NULL) {
+        if (*arg == '\0')
+            continue;
+        if (argc == CONFIG_SYS_MAXARGS)
+            return -EAGAIN;
+        argv[argc++] = arg;
+    }
+    argv[argc] = NULL;
+
+    // Leave empty, unknown and misused commands to the parser, which
+    // reports them.
+    if (argc == 0)
+        return -EAGAIN;
+
+    struct cmd_tbl *cmdtp = uboot_command_find(argv[0]);
+    if (cmdtp == NULL || argc > cmdtp->maxargs)
+        return -EAGAIN;
+
+    int ret = cmdtp->cmd(cmdtp, flag, argc, argv);
+    if (ret == CMD_RET_USAGE)
+        cmd_usage(cmdtp);
+
+    return (ret == CMD_RET_SUCCESS) ? 0 : 1;
+}
+
+static int parse_arg_type(const char *arg, enum arg_type_t *type)
+{
+    const char *conversion = strchr(arg, '%');
+
+    if (conversion == NULL) {
+        *type = ARG_FIXED;
+        return 0;
+    }
+
+    // Only arguments consisting of a single conversion are supported.
+    if (conversion != arg)
+        return -EINVAL;
+
+    if (!strcmp(arg, "%s"))
+        *type = ARG_STRING;
+    else if (!strcmp(arg, "%d") || !strcmp(arg, "%i"))
+        *type = ARG_INT;
+    else if (!strcmp(arg, "%u"))
+        *type = ARG_UINT;
+    else if (!strcmp(arg, "%x"))
+        *type = ARG_HEX;
+    else if (!strcmp(arg, "%lu"))
+        *type = ARG_ULONG;
+    else if (!strcmp(arg, "%lx"))
+        *type = ARG_HEX_ULONG;
+    else if (!strcmp(arg, "%p"))
+        *type = ARG_POINTER;
+    else
+        return -EINVAL;
+
+    return 0;
+}
+
+int uboot_command_prepare(const char *fmt)
+{
+    // Return immediately if library not initialised.
+    if (!uboot_wrapper_is_initialised())
+        return -1;
+
+    if (strlen(fmt) >= MAX_COMMAND_LENGTH)
+        return -EINVAL;
+
+    // Commands relying on the command line parser cannot be prepared.
+    if (strpbrk(fmt, PARSER_CHARACTERS) != NULL) {
+        UBOOT_LOGE("Command '%s' requires the command line parser", fmt);
+        return -EINVAL;
+    }
+
+    // Probe any devices required by the command not yet probed.
+    uboot_wrapper_ensure_for_command(fmt);
+
+    int handle;
+    for (handle = 0; handle < MAX_PREPARED_COMMANDS; handle++)
+        if (prepared_commands[handle] == NULL)
+            break;
+
+    if (handle == MAX_PREPARED_COMMANDS) {
+        UBOOT_LOGE("No free prepared command handles");
+        return -ENFILE;
+    }
+
+    struct prepared_command_t *command = calloc(1, sizeof(*command));
+    if (command == NULL)
+        return -ENOMEM;
+
+    // Split the format into arguments in place.
+    strcpy(command->format, fmt);
+    char *next = command->format;
+    char *arg;
+    while ((arg = strsep(&next, " \t")) != NULL) {
+        if (*arg == '\0')
+            continue;
+
+        if (command->argc == MAX_COMMAND_ARGS ||
+            parse_arg_type(arg, &command->types[command->argc]) != 0) {
+            UBOOT_LOGE("Unable to prepare command '%s'", fmt);
+            goto error;
+        }
+        command->argv[command->argc++] = arg;
+    }
+
+    if (command->argc == 0 || command->types[0] != ARG_FIXED)
+        goto error;
+
+    command->cmdtp = uboot_command_find(command->argv[0]);
+    if (command->cmdtp == NULL) {
+        UBOOT_LOGE("Unknown command '%s'", command->argv[0]);
+        goto error;
+    }
+
+    if (command->argc > command->cmdtp->maxargs) {
+        UBOOT_LOGE("Too many arguments for command '%s'", command->argv[0]);
+        goto error;
+    }
+
+    prepared_commands[handle] = command;
+    return handle;
+
+    error:
+        free(command);
+        return -EINVAL;
+}
+
+int uboot_command_exec(int handle, ...)
+{
+    // Fail immediately if library not initialised.
+    if (!uboot_wrapper_is_initialised())
+        return -1;
+
+    if (handle < 0 || handle >= MAX_PREPARED_COMMANDS || prepared_commands[handle] == NULL)
+        return -EBADF;
+
+    struct prepared_command_t *command = prepared_commands[handle];
+    char values[MAX_COMMAND_ARGS][MAX_ARG_LENGTH];
+    char *argv[MAX_COMMAND_ARGS + 1];
+    va_list args;
+
+    // Fill in the variable arguments.
+    va_start(args, handle);
+    for (int i = 0; i < command->argc; i++) {
+        switch (command->types[i]) {
+        case ARG_FIXED:
+            argv[i] = command->argv[i];
+            continue;
+        case ARG_STRING:
+            argv[i] = va_arg(args, char *);
+            continue;
+        case ARG_INT:
+            snprintf(values[i], MAX_ARG_LENGTH, "%d", va_arg(args, int));
+            break;
+        case ARG_UINT:
+            snprintf(values[i], MAX_ARG_LENGTH, "%u", va_arg(args, unsigned int));
+            break;
+        case ARG_HEX:
+            snprintf(values[i], MAX_ARG_LENGTH, "%x", va_arg(args, unsigned int));
+            break;
+        case ARG_ULONG:
+            snprintf(values[i], MAX_ARG_LENGTH, "%lu", va_arg(args, unsigned long));
+            break;
+        case ARG_HEX_ULONG:
+            snprintf(values[i], MAX_ARG_LENGTH, "%lx", va_arg(args, unsigned long));
+            break;
+        case ARG_POINTER:
+            snprintf(values[i], MAX_ARG_LENGTH, "%lx", (unsigned long)va_arg(args, void *));
+            break;
+        }
+        argv[i] = values[i];
+    }
+    va_end(args);
+    argv[command->argc] = NULL;
+
+    // Call the command directly, as the command line would once parsed, with
+    // the flag run_uboot_command passes.
+    int ret = command->cmdtp->cmd(command->cmdtp, CMD_FLAG_ENV, command->argc, argv);
+    if (ret == CMD_RET_USAGE)
+        cmd_usage(command->cmdtp);
+
+    return (ret == CMD_RET_SUCCESS) ? 0 : 1;
+}
+
+void uboot_command_release(int handle)
+{
+    if (handle < 0 || handle >= MAX_PREPARED_COMMANDS)
+        return;
+
+    free(prepared_commands[handle]);
+    prepared_commands[handle] = NULL;
+}
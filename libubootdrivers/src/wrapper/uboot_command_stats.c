@@ -0,0 +1,169 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides statistics of the commands run through
+ * run_uboot_command, so that the latency of storage and network commands
+ * can be monitored without a debugger. For each command name (the first
+ * word of the command string) the number of runs and failures, the maximum
+ * and total time taken, and a histogram of the time taken are kept. The
+ * histogram has a bucket per power of two microseconds. For file system
+ * load and write commands the number of bytes transferred is also counted.
+ *
+ * Statistics are only kept when the library is built with
+ * LIB_UBOOT_COMMAND_STATS set.
+ */
+
+#include <uboot_helper.h>
+#include <env.h>
+#include <uboot_wrapper.h>
+#include <uboot_drivers.h>
+
+#ifndef UBOOT_COMMAND_STATS
+#define UBOOT_COMMAND_STATS 0
+#endif
+
+#if UBOOT_COMMAND_STATS
+
+// The maximum number of command names for which statistics are kept.
+#define MAX_STATS_COMMANDS 16
+
+// The maximum length of a command name, including the terminating null.
+#define MAX_STATS_NAME 16
+
+// The number of histogram buckets. Bucket n counts commands taking from 2^n
+// to 2^(n+1) - 1 microseconds (bucket 0 also counts those taking 0), the
+// last bucket also counts any longer.
+#define STATS_BUCKETS 32
+
+struct command_stats_t {
+    char name[MAX_STATS_NAME];
+    unsigned long count;
+    unsigned long failures;
+    unsigned long long total_us;
+    unsigned long max_us;
+    unsigned long long bytes;
+    unsigned long buckets[STATS_BUCKETS];
+};
+
+static struct command_stats_t command_stats[MAX_STATS_COMMANDS];
+
+/* Copy the index'th word of a command string to 'word'. Returns false if
+ * the command has fewer words. */
+static bool get_word(const char *cmd, int index, char *word, size_t size)
+{
+    for (;;) {
+        cmd += strspn(cmd, " \t");
+        size_t length = strcspn(cmd, " \t;");
+        if (length == 0)
+            return false;
+
+        if (index-- == 0) {
+            if (length >= size)
+                length = size - 1;
+            memcpy(word, cmd, length);
+            word[length] = '\0';
+            return true;
+        }
+        cmd += length;
+    }
+}
+
+static bool ends_with(const char *name, const char *suffix)
+{
+    size_t name_length = strlen(name);
+    size_t suffix_length = strlen(suffix);
+
+    return name_length >= suffix_length &&
+        !strcmp(name + name_length - suffix_length, suffix);
+}
+
+/* Return the number of bytes transferred by a successful file system load
+ * or write command, or 0 for other commands. */
+static unsigned long long command_bytes(const char *name, const char *cmd)
+{
+    char size[24];
+
+    // Loads (e.g. 'fatload', 'ext4load', 'load') report the size read in
+    // the 'filesize' variable.
+    if (ends_with(name, "load"))
+        return env_get_hex("filesize", 0);
+
+    // Writes (e.g. 'fatwrite', 'ext4write', 'save') take the size to write
+    // as their fifth argument.
+    if ((ends_with(name, "write") || !strcmp(name, "save")) &&
+        get_word(cmd, 5, size, sizeof(size)))
+        return simple_strtoull(size, NULL, 16);
+
+    return 0;
+}
+
+static struct command_stats_t *find_command_stats(const char *name)
+{
+    for (int i = 0; i < MAX_STATS_COMMANDS; i++) {
+        if (command_stats[i].name[0] == '\0') {
+            strcpy(command_stats[i].name, name);
+            return &command_stats[i];
+        }
+        if (!strcmp(command_stats[i].name, name))
+            return &command_stats[i];
+    }
+
+    return NULL;
+}
+
+void uboot_command_stats_record(const char *cmd, unsigned long elapsed_us, int ret)
+{
+    char name[MAX_STATS_NAME];
+
+    if (!get_word(cmd, 0, name, sizeof(name)))
+        return;
+
+    struct command_stats_t *stats = find_command_stats(name);
+    if (stats == NULL)
+        return;
+
+    int bucket = 0;
+    while (bucket < STATS_BUCKETS - 1 && (elapsed_us >> (bucket + 1)) != 0)
+        bucket++;
+
+    stats->count++;
+    stats->total_us += elapsed_us;
+    if (elapsed_us > stats->max_us)
+        stats->max_us = elapsed_us;
+    stats->buckets[bucket]++;
+
+    if (ret != 0)
+        stats->failures++;
+    else
+        stats->bytes += command_bytes(name, cmd);
+}
+
+void uboot_dump_command_stats(void)
+{
+    printf("%-16s %8s %8s %12s %12s %14s\n",
+        "Command", "Runs", "Failed", "Mean (us)", "Max (us)", "Bytes");
+
+    for (int i = 0; i < MAX_STATS_COMMANDS && command_stats[i].name[0] != '\0'; i++) {
+        struct command_stats_t *stats = &command_stats[i];
+
+        printf("%-16s %8lu %8lu %12llu %12lu %14llu\n", stats->name, stats->count,
+            stats->failures, stats->total_us / stats->count, stats->max_us, stats->bytes);
+
+        // Print the buckets holding any commands, as the lower bound of the
+        // bucket and its count.
+        printf("   ");
+        for (int bucket = 0; bucket < STATS_BUCKETS; bucket++)
+            if (stats->buckets[bucket] != 0)
+                printf(" %lu:%lu", (bucket == 0) ? 0UL : 1UL << bucket, stats->buckets[bucket]);
+        printf("\n");
+    }
+}
+
+#else
+
+void uboot_command_stats_record(const char *cmd, unsigned long elapsed_us, int ret) {}
+void uboot_dump_command_stats(void) {}
+
+#endif
@@ -10,76 +10,221 @@
  *
  * Following successful initialisation within this file the 'uboot_wrapper'
  * is called to continue within the U-Boot 'world'.
+ *
+ * Initialisation creates a library context, holding the FDT and DMA manager
+ * used by the context and U-Boot's global data. Several contexts may exist
+ * at once, with the one in use selected through uboot_ctx_select.
  */
 
 #include <libfdt.h>
 #include <uboot_wrapper.h>
+#include <uboot_drivers.h>
 #include <utils/page.h>
 #include <dma.h>
 
-// The amount of extra space (in bytes) provided to our copy of the FDT to
-// allow sufficient space for modifications.
-#define EXTRA_FDT_BUFFER_SIZE 1024 * 8;
+// The maximum depth of node in the FDT.
+#define MAX_FDT_DEPTH 32
+
+// The status strings set on required and not required nodes.
+#define STATUS_OKAY "okay"
+#define STATUS_DISABLED "disabled"
 
-// Pointer to the FDT.
-static void* uboot_fdt_pointer = NULL;
+// The context used through initialise_uboot_drivers.
+static struct uboot_ctx *default_ctx = NULL;
 
-static int set_parent_status(int current_node, char *status_to_set)
+static bool is_device_node(int node, const int *device_nodes, uint32_t device_count)
 {
-    // Set status of this node.
-    int err = fdt_setprop_string(uboot_fdt_pointer, current_node, "status", status_to_set);
-    if (err != 0) {
-        UBOOT_LOGE("Failed to set 'status' with error %i. Buffer not big enough?", err);
-        return -1;
-    };
+    for (int dev_index=0; dev_index < device_count; dev_index++)
+        if (device_nodes[dev_index] == node)
+            return true;
+
+    return false;
+}
 
-    // Now set status of parent
-    int parent_node = fdt_parent_offset(uboot_fdt_pointer, current_node);
-    if (parent_node >= 0)
-        if (set_parent_status(parent_node, status_to_set) != 0)
+/* Mark the nodes to be left enabled in the 'required' bitmap, indexed by the
+ * order nodes appear in the FDT. These are the devices themselves, their
+ * parents and their children (recursively). Also returns the number of
+ * bytes by which setting the status of every node grows the FDT. */
+static int find_required_nodes(const void *fdt, const int *device_nodes,
+    uint32_t device_count, uint8_t *required, int *growth)
+{
+    int ancestors[MAX_FDT_DEPTH];
+    int subtree_depth = -1;
+    int depth = 0;
+    int index = 0;
+
+    // Allow for the 'status' string being added to the strings block.
+    *growth = sizeof("status");
+
+    for (int node = 0; node >= 0; node = fdt_next_node(fdt, node, &depth), index++) {
+        if (depth >= MAX_FDT_DEPTH) {
+            UBOOT_LOGE("FDT nodes nested too deeply");
             return -1;
+        }
+        ancestors[depth] = index;
+
+        // Leaving the subtree of a required device.
+        if (depth <= subtree_depth)
+            subtree_depth = -1;
+
+        if (is_device_node(node, device_nodes, device_count)) {
+            for (int level = 0; level <= depth; level++)
+                required[ancestors[level] / 8] |= 1 << (ancestors[level] % 8);
+            if (subtree_depth < 0)
+                subtree_depth = depth;
+        } else if (subtree_depth >= 0) {
+            required[index / 8] |= 1 << (index % 8);
+        }
+
+        // Account for the change in size of this node's 'status' property.
+        int len;
+        int status_len = (required[index / 8] & (1 << (index % 8))) ?
+            sizeof(STATUS_OKAY) : sizeof(STATUS_DISABLED);
+        if (fdt_getprop(fdt, node, "status", &len) != NULL)
+            *growth += FDT_TAGALIGN(status_len) - FDT_TAGALIGN(len);
+        else
+            *growth += sizeof(struct fdt_property) + FDT_TAGALIGN(status_len);
+    }
 
     return 0;
 }
 
-static int set_all_child_status(int parent_node, char *status_to_set)
+/* Write a copy of the FDT in which every node has a 'status' property, set
+ * from the 'required' bitmap. The copy is written in a single pass through
+ * the FDT using the sequential write functions of libfdt. */
+static int write_pruned_fdt(const void *fdt, void *buf, int bufsize, const uint8_t *required)
 {
-    // Set status of this node.
-    int err = fdt_setprop_string(uboot_fdt_pointer, parent_node, "status", status_to_set);
-    if (err != 0) {
-        UBOOT_LOGE("Failed to set 'status' with error %i. Buffer not bid enough?", err);
-        return -1;
-    };
+    int ret = fdt_create(buf, bufsize);
 
-    // Now set status of all children
-    int child_node;
-    fdt_for_each_subnode(child_node, uboot_fdt_pointer, parent_node)
-        if (set_all_child_status(child_node, status_to_set) != 0)
-            return -1;
+    // Copy the memory reservation map.
+    for (int rsv = 0; ret == 0 && rsv < fdt_num_mem_rsv(fdt); rsv++) {
+        uint64_t address, size;
+        ret = fdt_get_mem_rsv(fdt, rsv, &address, &size);
+        if (ret == 0)
+            ret = fdt_add_reservemap_entry(buf, address, size);
+    }
+    if (ret == 0)
+        ret = fdt_finish_reservemap(buf);
 
-    return 0;
+    // Copy the structure block, replacing the 'status' of each node. The
+    // new 'status' is written as the first property of each node.
+    int offset = 0;
+    int next;
+    int index = 0;
+    uint32_t tag;
+    do {
+        if (ret != 0)
+            break;
+
+        tag = fdt_next_tag(fdt, offset, &next);
+        switch (tag) {
+        case FDT_BEGIN_NODE:
+            ret = fdt_begin_node(buf, fdt_get_name(fdt, offset, NULL));
+            if (ret == 0)
+                ret = fdt_property_string(buf, "status",
+                    (required[index / 8] & (1 << (index % 8))) ? STATUS_OKAY : STATUS_DISABLED);
+            index++;
+            break;
+        case FDT_PROP: {
+            int len;
+            const struct fdt_property *prop = fdt_get_property_by_offset(fdt, offset, &len);
+            const char *name = fdt_string(fdt, fdt32_to_cpu(prop->nameoff));
+            if (strcmp(name, "status") != 0)
+                ret = fdt_property(buf, name, prop->data, len);
+            break;
+        }
+        case FDT_END_NODE:
+            ret = fdt_end_node(buf);
+            break;
+        case FDT_END:
+            ret = fdt_finish(buf);
+            break;
+        case FDT_NOP:
+            break;
+        default:
+            ret = -FDT_ERR_BADSTRUCTURE;
+            break;
+        }
+        offset = next;
+    } while (tag != FDT_END);
+
+    return ret;
 }
 
-static int disable_not_required_devices(const char **device_paths, uint32_t device_count)
+/* Create the copy of the FDT for U-Boot to use, with all devices not
+ * required disabled. The set of nodes to leave enabled is found first, and
+ * the copy then written in one pass, rather than modifying the 'status' of
+ * each node in place (which moves the remainder of the FDT each time). */
+static int create_pruned_fdt(const void *orig_fdt_blob, const char **device_paths,
+    uint32_t device_count, void **fdt_copy, struct uboot_profile *profile)
 {
-    // Start off by recursively disabling all devices in the device tree
-    if (set_all_child_status(fdt_path_offset(uboot_fdt_pointer, "/"), "disabled") != 0)
-        return -1;
+    int ret = -1;
+    int growth;
 
-    // Now set the status for all parents and children (recursively) of our used
-    // devices to 'okay'. This leaves only the minimum set of devices enabled
-    // which we actually require.
+    // Every node occupies at least 12 bytes of the structure block.
+    uint8_t *required = calloc(fdt_size_dt_struct(orig_fdt_blob) / 12 / 8 + 1, 1);
+    int *device_nodes = calloc(device_count, sizeof(int));
+    if (required == NULL || device_nodes == NULL)
+        goto out;
+
+    int phase = uboot_profile_begin(profile, "fdt prune");
     for (int dev_index=0; dev_index < device_count; dev_index++) {
-        if (set_parent_status(fdt_path_offset(uboot_fdt_pointer, device_paths[dev_index]), "okay") != 0)
-            return -1;
-        if (set_all_child_status(fdt_path_offset(uboot_fdt_pointer, device_paths[dev_index]), "okay") != 0)
-            return -1;
+        device_nodes[dev_index] = fdt_path_offset(orig_fdt_blob, device_paths[dev_index]);
+        if (device_nodes[dev_index] < 0) {
+            UBOOT_LOGE("Device '%s' not found in FDT", device_paths[dev_index]);
+            uboot_profile_end(profile, phase);
+            goto out;
+        }
     }
 
-    return 0;
+    int found = find_required_nodes(orig_fdt_blob, device_nodes, device_count, required, &growth);
+    uboot_profile_end(profile, phase);
+    if (found != 0)
+        goto out;
+
+    // The copy differs from the original only by the 'status' properties,
+    // plus any alignment of the blocks within the FDT.
+    int fdt_size = fdt_totalsize(orig_fdt_blob) + growth + sizeof(struct fdt_reserve_entry);
+    phase = uboot_profile_begin(profile, "fdt copy");
+    *fdt_copy = malloc(fdt_size);
+    if (*fdt_copy == NULL) {
+        uboot_profile_end(profile, phase);
+        goto out;
+    }
+
+    ret = write_pruned_fdt(orig_fdt_blob, *fdt_copy, fdt_size, required);
+    if (ret != 0)
+        UBOOT_LOGE("Failed to write FDT with error %i", ret);
+    uboot_profile_end(profile, phase);
+
+    out:
+        free(required);
+        free(device_nodes);
+        return ret;
 }
 
-int initialise_uboot_drivers(
+#if UBOOT_LIVE_TREE
+/* Check the devices requested are those the live tree was generated for, as
+ * the status of its nodes cannot be changed at run time. */
+static bool live_tree_matches(const char **device_paths, uint32_t device_count)
+{
+    if (device_count != uboot_live_tree_path_count)
+        return false;
+
+    for (int dev_index = 0; dev_index < device_count; dev_index++) {
+        int path_index;
+        for (path_index = 0; path_index < uboot_live_tree_path_count; path_index++)
+            if (!strcmp(device_paths[dev_index], uboot_live_tree_paths[path_index]))
+                break;
+        if (path_index == uboot_live_tree_path_count)
+            return false;
+    }
+
+    return true;
+}
+#endif
+
+uboot_ctx_t *uboot_ctx_create(
     ps_dma_man_t dma_manager,
     const char *orig_fdt_blob,
     const char **dev_paths,
@@ -88,65 +233,107 @@ int initialise_uboot_drivers(
     // Return immediately if no devices have been requested.
     if (0 == dev_count || NULL == dev_paths) {
         UBOOT_LOGE("Library initialisation cancelled, no devices supplied");
-        return -1;
+        return NULL;
     }
 
-    int ret;
-
-    // Create a copy of the FDT for U-Boot to use. We do this using
-    // 'fdt_open_into' to open the FDT into a larger buffer to allow
-    // us extra space to make modifications as required.
-
     if (orig_fdt_blob == NULL) {
         UBOOT_LOGE("Unable to access FDT");
-        return -1;
+        return NULL;
     }
 
-    int fdt_size = fdt_totalsize(orig_fdt_blob) + EXTRA_FDT_BUFFER_SIZE;
-    uboot_fdt_pointer = malloc(fdt_size);
-    if (uboot_fdt_pointer == NULL)
-        return -ENOMEM;
+#if UBOOT_LIVE_TREE
+    if (!live_tree_matches(dev_paths, dev_count)) {
+        UBOOT_LOGE("Devices requested differ from those of the generated live tree");
+        return NULL;
+    }
+#endif
 
-    ret = fdt_open_into(orig_fdt_blob, uboot_fdt_pointer, fdt_size);
-    if (0 != ret)
-        goto error;
+    struct uboot_ctx *ctx = calloc(1, sizeof(*ctx));
+    if (ctx == NULL)
+        return NULL;
+
+    // Keep our own copy of the DMA manager, the caller's need not outlive
+    // this call.
+    ctx->dma_manager = dma_manager;
+
+    // Profile initialisation from here on.
+    uboot_profile_start(&ctx->profile);
 
-    // Start by disabling all devices in the FDT that are not required.
-    ret = disable_not_required_devices(dev_paths, dev_count);
-    if (0 != ret)
+    char *fdt_blob;
+#if UBOOT_LIVE_TREE
+    // If a live tree was generated at build time the devices not required
+    // have already been disabled in it, and U-Boot only reads the FDT. Use
+    // the original FDT rather than a modified copy.
+    fdt_blob = (char *)orig_fdt_blob;
+#else
+    // Create a copy of the FDT for U-Boot to use with all devices that are
+    // not required disabled.
+    if (create_pruned_fdt(orig_fdt_blob, dev_paths, dev_count, &ctx->fdt_copy,
+        &ctx->profile) != 0)
         goto error;
+    fdt_blob = ctx->fdt_copy;
+#endif
 
     // Map the required device resources for all required devices.
     // ret = map_required_device_resources(reg_paths, reg_count);
     // if (0 != ret)
     //     goto error;
 
-    // Initalise microkit DMA, cached is set to true in the system file
-    sel4_dma_initialise(&dma_manager);
-
-    // Start the U-Boot wrapper. Provide it a pointer to the FDT blob.
-    ret = initialise_uboot_wrapper(uboot_fdt_pointer);
-    
-    if (0 != ret)
+    // Start the U-Boot wrapper for the context. Provide it a pointer to the
+    // FDT blob. This also selects the context, and so its DMA manager.
+    if (initialise_uboot_wrapper(ctx, fdt_blob) != 0)
         goto error;
 
     // All done.
-    return 0;
+    return ctx;
 
     error:
-        // Failed to initialise library, clean up and return error code.
-        free(uboot_fdt_pointer);
-        uboot_fdt_pointer = NULL;
+        // Failed to initialise context, clean up and return error. Drivers
+        // may have allocated DMA memory before the failure.
+        sel4_dma_shutdown(&ctx->dma_manager);
+        free(ctx->fdt_copy);
+        free(ctx);
+        return NULL;
+}
+
+int uboot_ctx_select(uboot_ctx_t *ctx)
+{
+    if (ctx == NULL || !ctx->initialised)
         return -1;
+
+    uboot_wrapper_select(ctx);
+    return 0;
 }
 
-void shutdown_uboot_drivers(void) {
-    if (uboot_fdt_pointer != NULL) {
-        free(uboot_fdt_pointer);
-        uboot_fdt_pointer = NULL;
-    }
+void uboot_ctx_destroy(uboot_ctx_t *ctx)
+{
+    if (ctx == NULL)
+        return;
+
+    shutdown_uboot_wrapper(ctx);
+
+    sel4_dma_shutdown(&ctx->dma_manager);
+
+    free(ctx->fdt_copy);
+    free(ctx);
+}
+
+int initialise_uboot_drivers(
+    ps_dma_man_t dma_manager,
+    const char *orig_fdt_blob,
+    const char **dev_paths,
+    uint32_t dev_count)
+{
+    // If already initialised there is nothing to do other than to make the
+    // context the one in use again.
+    if (default_ctx != NULL)
+        return uboot_ctx_select(default_ctx);
 
-    shutdown_uboot_wrapper();
+    default_ctx = uboot_ctx_create(dma_manager, orig_fdt_blob, dev_paths, dev_count);
+    return (default_ctx == NULL) ? -1 : 0;
+}
 
-    sel4_dma_shutdown();
-}
\ No newline at end of file
+void shutdown_uboot_drivers(void) {
+    uboot_ctx_destroy(default_ctx);
+    default_ctx = NULL;
+}
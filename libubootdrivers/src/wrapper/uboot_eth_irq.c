@@ -0,0 +1,171 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides interrupt driven reception of Ethernet packets. The
+ * FEC's receive interrupt is delivered to the protection domain as a Microkit
+ * notification and passed to uboot_eth_irq_handler, which delivers received
+ * packets to a caller supplied handler.
+ *
+ * Reception adapts to the packet rate in the style of Linux's NAPI. On an
+ * interrupt, further receive interrupts are masked and the receive ring is
+ * polled for up to a budget of packets. If the ring is drained within the
+ * budget, interrupts are unmasked again; otherwise reception stays in polling
+ * mode and the caller continues to drain the ring through uboot_eth_poll,
+ * avoiding an interrupt per packet under load.
+ */
+
+#include <uboot_helper.h>
+#include <dm.h>
+#include <clk.h>
+#include <miiphy.h>
+#include <net.h>
+#include <asm/io.h>
+#include <uboot_wrapper.h>
+#include <uboot_drivers.h>
+
+#ifdef CONFIG_FEC_MXC
+
+#include <fec_mxc.h>
+
+// The maximum number of packets received per interrupt or call to
+// uboot_eth_poll before returning to the caller.
+#define ETH_POLL_BUDGET 16
+
+// Channel the FEC receive interrupt is delivered on, -1 if not in use.
+static int eth_irq_channel = -1;
+
+static uboot_eth_rx_handler_t eth_rx_handler;
+static void *eth_rx_cookie;
+
+// Set while receive interrupts are masked and the ring is being polled.
+static bool eth_polling;
+
+static struct ethernet_regs *get_fec_regs(void)
+{
+    struct udevice *current = eth_get_dev();
+    if (!current || !eth_is_active(current))
+        return NULL;
+
+    struct fec_priv *fec = dev_get_priv(current);
+    return fec->eth;
+}
+
+/* Receive up to ETH_POLL_BUDGET packets, passing each to the receive
+ * handler. Returns the number of packets received or negative on error. */
+static int eth_poll_budget(void)
+{
+    struct udevice *current = eth_get_dev();
+    if (!current || !eth_is_active(current))
+        return -ENODEV;
+
+    const struct eth_ops *ops = eth_get_ops(current);
+    int flags = ETH_RECV_CHECK_DEVICE;
+    int received;
+
+    for (received = 0; received < ETH_POLL_BUDGET; received++) {
+        uchar *packet;
+        int ret = ops->recv(current, flags, &packet);
+        flags = 0;
+
+        if (ret == 0 && ops->free_pkt)
+            ops->free_pkt(current, packet, ret);
+        if (ret == -EAGAIN || ret == 0)
+            break;
+        if (ret < 0)
+            return ret;
+
+        eth_rx_handler(packet, ret, eth_rx_cookie);
+
+        if (ops->free_pkt)
+            ops->free_pkt(current, packet, ret);
+    }
+
+    return received;
+}
+
+/* Poll the receive ring once. If it was drained within the budget, leave
+ * polling mode and unmask receive interrupts. Returns 1 if still polling,
+ * 0 if interrupts have been re-armed, or negative on error. */
+static int eth_poll_and_rearm(void)
+{
+    struct ethernet_regs *regs = get_fec_regs();
+    if (regs == NULL)
+        return -ENODEV;
+
+    int ret = eth_poll_budget();
+    if (ret < 0)
+        return ret;
+
+    if (ret == ETH_POLL_BUDGET)
+        return 1;
+
+    // The ring is empty. Any frame arriving from here on sets the (already
+    // cleared) RXF event, so unmasking cannot miss a packet. The interrupt
+    // mask shares its bit layout with the event register.
+    eth_polling = false;
+    writel(readl(&regs->imask) | FEC_IEVENT_RXF, &regs->imask);
+    return 0;
+}
+
+int uboot_eth_irq_init(int channel, uboot_eth_rx_handler_t handler, void *cookie)
+{
+    // Return immediately if library not initialised.
+    if (!uboot_wrapper_is_initialised())
+        return -1;
+
+    // The FEC driver masks all interrupts when started, so interrupts can
+    // only be enabled once uboot_eth_init has been called.
+    struct ethernet_regs *regs = get_fec_regs();
+    if (regs == NULL) {
+        UBOOT_LOGE("Ethernet not initialised");
+        return -ENODEV;
+    }
+
+    eth_irq_channel = channel;
+    eth_rx_handler = handler;
+    eth_rx_cookie = cookie;
+    eth_polling = false;
+
+    // Discard stale events then enable the receive frame interrupt.
+    writel(FEC_IEVENT_RXF, &regs->ievent);
+    writel(readl(&regs->imask) | FEC_IEVENT_RXF, &regs->imask);
+    microkit_irq_ack(channel);
+
+    return 0;
+}
+
+int uboot_eth_irq_handler(int channel)
+{
+    if (channel != eth_irq_channel || eth_rx_handler == NULL)
+        return 0;
+
+    struct ethernet_regs *regs = get_fec_regs();
+    if (regs == NULL)
+        return -ENODEV;
+
+    // Mask further receive interrupts and clear the event before polling.
+    writel(readl(&regs->imask) & ~FEC_IEVENT_RXF, &regs->imask);
+    writel(FEC_IEVENT_RXF, &regs->ievent);
+    eth_polling = true;
+    microkit_irq_ack(channel);
+
+    return eth_poll_and_rearm();
+}
+
+int uboot_eth_poll(void)
+{
+    if (!eth_polling)
+        return 0;
+
+    return eth_poll_and_rearm();
+}
+
+#else
+
+int uboot_eth_irq_init(int channel, uboot_eth_rx_handler_t handler, void *cookie) { return -ENODEV; }
+int uboot_eth_irq_handler(int channel) { return 0; }
+int uboot_eth_poll(void) { return 0; }
+
+#endif
@@ -0,0 +1,266 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides file handles for appending to files on a block device
+ * partition. It is intended for logs and similar files that are repeatedly
+ * extended, which would otherwise be written with a 'fatwrite' command per
+ * update.
+ *
+ * The block device and partition are resolved once when the file is opened
+ * rather than on every write, and the size of the file is tracked by the
+ * handle. Appended data is held in a buffer and written to the file when the
+ * buffer fills or the handle is synchronised, so that the cost of locating
+ * the end of the file is incurred once per buffer rather than once per
+ * append.
+ *
+ * When a file on a FAT partition is opened, the start of the partition's
+ * allocation table is pinned in the block cache. The FAT driver searches
+ * the table from its start for free clusters each time a file grows, so on
+ * a well used card each append would otherwise re-read much of the table
+ * from the device.
+ */
+
+#include <uboot_helper.h>
+#include <blk.h>
+#include <part.h>
+#include <fs.h>
+#include <memalign.h>
+#include <asm/unaligned.h>
+#include <uboot_wrapper.h>
+#include <uboot_drivers.h>
+
+#ifdef CONFIG_FS_FAT
+
+// The maximum number of files that may be open at once.
+#define MAX_FS_HANDLES 4
+
+// The size (in bytes) of the buffer holding appended data for each handle.
+#define FS_APPEND_BUFFER_BYTES (16 * 1024)
+
+// The maximum length of a file name, including the terminating null.
+#define FS_MAX_FILENAME 256
+
+struct fs_handle_t {
+    bool in_use;
+    // Context through which the file was opened.
+    struct uboot_ctx *ctx;
+    // Block device and partition number holding the file.
+    struct blk_desc *desc;
+    int part;
+    char filename[FS_MAX_FILENAME];
+    // Size of the file on the device, excluding buffered data.
+    loff_t size;
+    // Appended data not yet written to the device.
+    char *buffer;
+    size_t buffered;
+};
+
+static struct fs_handle_t fs_handles[MAX_FS_HANDLES];
+
+/* If the partition holds a FAT file system, pin the first copy of its
+ * allocation table in the block cache. */
+static void pin_fat(struct blk_desc *desc, struct disk_partition *info)
+{
+    ALLOC_CACHE_ALIGN_BUFFER(u8, sector, desc->blksz);
+
+    if (desc->blksz != 512 || blk_dread(desc, info->start, 1, sector) != 1)
+        return;
+
+    // Check the boot sector signature and file system type.
+    if (sector[510] != 0x55 || sector[511] != 0xaa ||
+        (memcmp(&sector[54], "FAT", 3) && memcmp(&sector[82], "FAT32", 5)))
+        return;
+
+    // The table follows the reserved sectors. FAT12/16 give its length in a
+    // 16 bit field, FAT32 sets that field to zero and uses a 32 bit field.
+    unsigned long reserved = get_unaligned_le16(&sector[14]);
+    unsigned long fat_length = get_unaligned_le16(&sector[22]);
+    if (fat_length == 0)
+        fat_length = get_unaligned_le32(&sector[36]);
+    if (reserved == 0 || fat_length == 0)
+        return;
+
+    uboot_blk_cache_pin(desc->bdev, info->start + reserved, fat_length);
+}
+
+static struct fs_handle_t *handle_to_fs(int handle)
+{
+    if (!uboot_wrapper_is_initialised())
+        return NULL;
+
+    if (handle < 0 || handle >= MAX_FS_HANDLES || !fs_handles[handle].in_use)
+        return NULL;
+
+    // The file's device belongs to the driver model of the context that
+    // opened it.
+    if (fs_handles[handle].ctx != uboot_wrapper_get_ctx())
+        return NULL;
+
+    return &fs_handles[handle];
+}
+
+int uboot_fs_open(const char *if_typename, const char *dev_part_str, const char *filename)
+{
+    // Return immediately if library not initialised.
+    if (!uboot_wrapper_is_initialised())
+        return -1;
+
+    if (strlen(filename) >= FS_MAX_FILENAME)
+        return -ENAMETOOLONG;
+
+    int handle;
+    for (handle = 0; handle < MAX_FS_HANDLES; handle++)
+        if (!fs_handles[handle].in_use)
+            break;
+
+    if (handle == MAX_FS_HANDLES) {
+        UBOOT_LOGE("No free file handles");
+        return -ENFILE;
+    }
+
+    struct fs_handle_t *fs = &fs_handles[handle];
+    struct disk_partition info;
+
+    if (!strcmp(if_typename, "mmc") && uboot_wrapper_ensure_mmc())
+        return -ENODEV;
+
+    // Resolve the block device and partition once for the life of the handle.
+    fs->part = blk_get_device_part_str(if_typename, dev_part_str, &fs->desc, &info, 1);
+    if (fs->part < 0) {
+        UBOOT_LOGE("No partition %s %s", if_typename, dev_part_str);
+        return -ENODEV;
+    }
+
+    pin_fat(fs->desc, &info);
+
+    // Find the current size of the file, if it exists.
+    if (fs_set_blk_dev_with_part(fs->desc, fs->part))
+        return -ENODEV;
+    if (fs_size(filename, &fs->size) < 0)
+        fs->size = 0;
+
+    fs->buffer = malloc(FS_APPEND_BUFFER_BYTES);
+    if (fs->buffer == NULL)
+        return -ENOMEM;
+
+    strcpy(fs->filename, filename);
+    fs->buffered = 0;
+    fs->ctx = uboot_wrapper_get_ctx();
+    fs->in_use = true;
+
+    return handle;
+}
+
+/* Write the buffered data to the file. The data remains buffered unless it
+ * was all written. As data is written at the end of the file as it stood
+ * before the write, writing it again after a failure does not duplicate it. */
+static int write_buffered(struct fs_handle_t *fs)
+{
+    if (fs->buffered == 0)
+        return 0;
+
+    // Each file system operation closes the file system, so it must be
+    // selected again before every write.
+    if (fs_set_blk_dev_with_part(fs->desc, fs->part))
+        return -ENODEV;
+
+    loff_t written;
+    int ret = fs_write(fs->filename, (ulong)fs->buffer, fs->size, fs->buffered, &written);
+    if (ret < 0 || written != fs->buffered) {
+        UBOOT_LOGE("Failed to write %s", fs->filename);
+        return -EIO;
+    }
+
+    fs->size += fs->buffered;
+    fs->buffered = 0;
+
+    return 0;
+}
+
+int uboot_fs_sync(int handle)
+{
+    struct fs_handle_t *fs = handle_to_fs(handle);
+    if (fs == NULL)
+        return -EBADF;
+
+    int ret = write_buffered(fs);
+    if (ret < 0)
+        return ret;
+
+    // Ensure the data (and file system metadata) has reached the device
+    // rather than being held by the block cache. This is done even if
+    // nothing was buffered, as an earlier sync may have written the data
+    // but failed to flush it.
+    if (uboot_blk_cache_flush(fs->desc->bdev))
+        return -EIO;
+
+    return 0;
+}
+
+int uboot_fs_append(int handle, const void *data, size_t length)
+{
+    struct fs_handle_t *fs = handle_to_fs(handle);
+    if (fs == NULL)
+        return -EBADF;
+
+    const char *src = data;
+
+    while (length > 0) {
+        size_t space = FS_APPEND_BUFFER_BYTES - fs->buffered;
+        size_t chunk = (length < space) ? length : space;
+
+        memcpy(fs->buffer + fs->buffered, src, chunk);
+        fs->buffered += chunk;
+        src += chunk;
+        length -= chunk;
+
+        // Write out a full buffer. Its data need not reach the device
+        // until the next sync, so the block cache is not flushed.
+        if (fs->buffered == FS_APPEND_BUFFER_BYTES) {
+            int ret = write_buffered(fs);
+            if (ret < 0) {
+                // Nothing was written, so drop the chunk so that the caller
+                // can append it again without it also being written by a
+                // later sync.
+                fs->buffered -= chunk;
+                return ret;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int uboot_fs_close(int handle)
+{
+    struct fs_handle_t *fs = handle_to_fs(handle);
+    if (fs == NULL)
+        return -EBADF;
+
+    int ret = uboot_fs_sync(handle);
+
+    free(fs->buffer);
+    fs->buffer = NULL;
+    fs->in_use = false;
+
+    return ret;
+}
+
+void uboot_fs_close_all(struct uboot_ctx *ctx)
+{
+    for (int handle = 0; handle < MAX_FS_HANDLES; handle++)
+        if (fs_handles[handle].in_use && fs_handles[handle].ctx == ctx)
+            uboot_fs_close(handle);
+}
+
+#else
+
+void uboot_fs_close_all(struct uboot_ctx *ctx) {}
+int uboot_fs_open(const char *if_typename, const char *dev_part_str, const char *filename) { return -ENODEV; }
+int uboot_fs_append(int handle, const void *data, size_t length) { return -EBADF; }
+int uboot_fs_sync(int handle) { return -EBADF; }
+int uboot_fs_close(int handle) { return -EBADF; }
+
+#endif
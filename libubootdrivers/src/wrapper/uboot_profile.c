@@ -0,0 +1,193 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ *
+ * This file provides the profile of a context's initialisation. Each phase
+ * of initialisation (copying the FDT, building the live tree, binding and
+ * probing devices, etc.) is recorded with the system counter value at its
+ * start and end. Counter values are only converted to times when the
+ * profile is read, so recording a phase costs two reads of the counter.
+ *
+ * The profile can be printed as a table, sorted by the time taken by each
+ * phase, or as base64 encoded CBOR (an array of maps with "name",
+ * "start_us" and "duration_us" keys) for offline processing, in the form
+ * written by libutils' cbor64 streams. The CBOR is encoded here as cbor64
+ * writes to a C library FILE, which is not available to code built against
+ * U-Boot's headers.
+ *
+ * Nothing is recorded on platforms without a timer that can be read.
+ */
+
+#include <uboot_helper.h>
+#include <sel4_timer.h>
+#include <uboot_wrapper.h>
+#include <uboot_drivers.h>
+
+// CBOR major types used by the profile.
+#define CBOR_UNSIGNED_INT 0
+#define CBOR_UTF8_STRING 3
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+
+static const char base64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Base64 encoder state; bits of the last byte not yet written.
+struct base64_out_t {
+    unsigned int buffer;
+    int bits;
+};
+
+void uboot_profile_start(struct uboot_profile *profile)
+{
+    profile->start_ticks = 0;
+    profile->count = 0;
+
+    if (!UBOOT_HAVE_TIMER)
+        return;
+
+    // The profile of the first context starts before the wrapper starts the
+    // timer. Starting the timer again has no effect on the count.
+    initialise_and_start_timer();
+
+    profile->start_ticks = get_ticks();
+}
+
+int uboot_profile_begin(struct uboot_profile *profile, const char *name)
+{
+    if (!UBOOT_HAVE_TIMER || profile->count == UBOOT_PROFILE_MAX_PHASES)
+        return -1;
+
+    struct uboot_profile_record *record = &profile->records[profile->count];
+    record->name = name;
+    record->start_ticks = get_ticks();
+    record->end_ticks = record->start_ticks;
+
+    return profile->count++;
+}
+
+void uboot_profile_end(struct uboot_profile *profile, int phase)
+{
+    if (phase >= 0 && phase < profile->count)
+        profile->records[phase].end_ticks = get_ticks();
+}
+
+int uboot_get_init_profile(struct uboot_init_phase *phases, int max)
+{
+    // Return immediately if library not initialised.
+    if (!uboot_wrapper_is_initialised())
+        return -1;
+
+    struct uboot_profile *profile = uboot_wrapper_get_profile();
+    int count = (profile->count < max) ? profile->count : max;
+
+    for (int i = 0; i < count; i++) {
+        struct uboot_profile_record *record = &profile->records[i];
+        phases[i].name = record->name;
+        phases[i].start_us = timer_ticks_to_us(record->start_ticks - profile->start_ticks);
+        phases[i].duration_us = timer_ticks_to_us(record->end_ticks - record->start_ticks);
+    }
+
+    return count;
+}
+
+static void print_profile_table(struct uboot_init_phase *phases, int count)
+{
+    int order[UBOOT_PROFILE_MAX_PHASES];
+
+    // Insertion sort by duration, longest first.
+    for (int i = 0; i < count; i++) {
+        int j = i;
+        while (j > 0 && phases[order[j - 1]].duration_us < phases[i].duration_us) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    printf("%-24s %12s %12s\n", "Phase", "Start (us)", "Time (us)");
+    for (int i = 0; i < count; i++)
+        printf("%-24s %12lu %12lu\n", phases[order[i]].name,
+            phases[order[i]].start_us, phases[order[i]].duration_us);
+}
+
+static void base64_byte(struct base64_out_t *out, uint8_t byte)
+{
+    out->buffer = (out->buffer << 8) | byte;
+    out->bits += 8;
+
+    while (out->bits >= 6) {
+        out->bits -= 6;
+        putc(base64_chars[(out->buffer >> out->bits) & 0x3f]);
+    }
+}
+
+static void base64_end(struct base64_out_t *out)
+{
+    if (out->bits == 0)
+        return;
+
+    int padding = 6 - out->bits;
+    putc(base64_chars[(out->buffer << padding) & 0x3f]);
+    for (; padding > 0; padding -= 2)
+        putc('=');
+}
+
+/* Write the initial bytes of a CBOR item, holding its type and value (or
+ * length). */
+static void cbor_head(struct base64_out_t *out, int type, uint64_t value)
+{
+    if (value < 24) {
+        base64_byte(out, (type << 5) | value);
+        return;
+    }
+
+    int bytes = (value <= 0xff) ? 1 : (value <= 0xffff) ? 2 : (value <= 0xffffffff) ? 4 : 8;
+    base64_byte(out, (type << 5) | ((bytes == 1) ? 24 : (bytes == 2) ? 25 : (bytes == 4) ? 26 : 27));
+    while (bytes-- > 0)
+        base64_byte(out, value >> (bytes * 8));
+}
+
+static void cbor_text(struct base64_out_t *out, const char *text)
+{
+    size_t length = strlen(text);
+
+    cbor_head(out, CBOR_UTF8_STRING, length);
+    for (size_t i = 0; i < length; i++)
+        base64_byte(out, text[i]);
+}
+
+static void print_profile_cbor(struct uboot_init_phase *phases, int count)
+{
+    struct base64_out_t out = { 0 };
+
+    cbor_head(&out, CBOR_ARRAY, count);
+    for (int i = 0; i < count; i++) {
+        cbor_head(&out, CBOR_MAP, 3);
+        cbor_text(&out, "name");
+        cbor_text(&out, phases[i].name);
+        cbor_text(&out, "start_us");
+        cbor_head(&out, CBOR_UNSIGNED_INT, phases[i].start_us);
+        cbor_text(&out, "duration_us");
+        cbor_head(&out, CBOR_UNSIGNED_INT, phases[i].duration_us);
+    }
+    base64_end(&out);
+    putc('\n');
+}
+
+int uboot_print_init_profile(bool cbor)
+{
+    struct uboot_init_phase phases[UBOOT_PROFILE_MAX_PHASES];
+
+    int count = uboot_get_init_profile(phases, UBOOT_PROFILE_MAX_PHASES);
+    if (count < 0)
+        return count;
+
+    if (cbor)
+        print_profile_cbor(phases, count);
+    else
+        print_profile_table(phases, count);
+
+    return 0;
+}
@@ -8,12 +8,13 @@
 #include <uboot_helper.h>
 #include <dm/root.h>
 #include <dm/util.h>
+#include <dm/uclass.h>
+#include <dm/device-internal.h>
 #include <usb.h>
 #include <asm/global_data.h>
 #include <fdtdec.h>
 #include <of_live.h>
-#include <driver_data_limits.h>
-#include <driver_data.h>
+#include <dm/of_access.h>
 #include <stdio_dev.h>
 #include <console.h>
 #include <mmc.h>
@@ -21,6 +22,8 @@
 #include <env.h>
 #include <command.h>
 #include <sel4_timer.h>
+#include <uboot_wrapper.h>
+#include <uboot_drivers.h>
 
 //libmicrokit
 #include <stdio.h>
@@ -33,58 +36,299 @@ extern uintptr_t __heap_start;
 // Global declaration of global_data.
 struct global_data* gd;
 
-// Global declaration of driver_data.
-struct driver_data_t driver_data;
-
-// Global declaration and initialisation of driver_data_start/end.
-const struct driver_data_pointer_t driver_data_start = {
-    .driver_start = driver_data.driver_array,
-    .uclass_driver_start = driver_data.uclass_driver_array,
-    .usb_driver_entry_start = driver_data.usb_driver_entry_array,
-    .cmd_start = driver_data.cmd_array,
-    .part_driver_start = driver_data.part_driver_array,
-    .env_driver_start = driver_data.env_driver_array,
-    .env_clbk_start = driver_data.env_clbk_array,
-    .driver_info_start = driver_data.driver_info_array,
-    .udevice_start = driver_data.udevice_array
-};
-
-const struct driver_data_pointer_t driver_data_end = {
-    .driver_start = &driver_data.driver_array[_u_boot_driver_count],
-    .uclass_driver_start = &driver_data.uclass_driver_array[_u_boot_uclass_driver_count],
-    .usb_driver_entry_start = &driver_data.usb_driver_entry_array[_u_boot_usb_driver_entry_count],
-    .cmd_start = &driver_data.cmd_array[_u_boot_cmd_count],
-    .part_driver_start = &driver_data.part_driver_array[_u_boot_part_driver_count],
-    .env_driver_start = &driver_data.env_driver_array[_u_boot_env_driver_count],
-    .env_clbk_start = &driver_data.env_clbk_array[_u_boot_env_clbk_count],
-    .driver_info_start = &driver_data.driver_info_array[_u_boot_driver_info_count],
-    .udevice_start = &driver_data.udevice_array[_u_boot_udevice_count]
-};
-
 // Global declaration of version_string.
 const char version_string[] = "seL4 U-Boot driver";
 
 // Global declaration and initialisation of the default load address.
 ulong image_load_addr = CONFIG_SYS_LOAD_ADDR;
 
-// State determining whether the library has been initialised.
-static bool library_initialised = false;
+// The library context in use, NULL if none. The context holds the
+// U-Boot global data ('gd') and the wrapper's state for its devices.
+static struct uboot_ctx *current_ctx = NULL;
+
+// The number of initialised contexts. State shared between contexts (the
+// timer and block cache) is set up with the first context and released with
+// the last.
+static int ctx_count = 0;
+
+#ifndef UBOOT_LAZY_PROBE
+#define UBOOT_LAZY_PROBE 0
+#endif
+
+#ifndef UBOOT_COMMAND_STATS
+#define UBOOT_COMMAND_STATS 0
+#endif
+
+// Commands requiring the MMC or Ethernet devices, identified by the start of
+// the command name, so that these can be probed on first use in lazy mode.
+// The block device commands apply to any interface, so only require the MMC
+// devices when given 'mmc' as an argument (e.g. 'fatls mmc 0:1').
+static const char *const mmc_command_prefixes[] = {
+    "mmc"
+};
+static const char *const blk_command_prefixes[] = {
+    "fat", "ext", "part", "ls", "load", "save", "size"
+};
+static const char *const eth_command_prefixes[] = {
+    "ping", "tftp", "dhcp", "dns", "net", "sntp", "nfs"
+};
+
+// Uclasses probed a device at a time by uboot_init_step, and the position
+// of the next device to probe.
+static const enum uclass_id init_step_uclasses[] = {
+#ifdef CONFIG_DM_MMC
+    UCLASS_MMC,
+#endif
+#ifdef CONFIG_NET
+    UCLASS_ETH,
+#endif
+};
+
+/* Probe a device, logging the time taken and the time since initialisation
+ * started at which it became ready. */
+static int probe_device(struct udevice *dev)
+{
+#if UBOOT_HAVE_TIMER
+    unsigned long start = timer_get_us();
+    int phase = uboot_profile_begin(&current_ctx->profile, dev->name);
+    int ret = device_probe(dev);
+    uboot_profile_end(&current_ctx->profile, phase);
+    unsigned long end = timer_get_us();
+
+    if (ret)
+        UBOOT_LOGE("Failed to probe %s (%i) after %lu us", dev->name, ret, end - start);
+    else
+        UBOOT_LOGI("Probed %s in %lu us, ready at %lu us", dev->name, end - start,
+            end - current_ctx->init_start_us);
+#else
+    int ret = device_probe(dev);
+
+    if (ret)
+        UBOOT_LOGE("Failed to probe %s (%i)", dev->name, ret);
+    else
+        UBOOT_LOGI("Probed %s", dev->name);
+#endif
+
+    return ret;
+}
+
+/* Probe each device of a uclass not already probed. */
+static void probe_uclass_devices(enum uclass_id id)
+{
+    struct uclass *uc;
+    struct udevice *dev;
+
+    if (uclass_get(id, &uc))
+        return;
+
+    uclass_foreach_dev(dev, uc)
+        if (!device_active(dev))
+            probe_device(dev);
+}
+
+/* Return the index'th device of a uclass, or NULL if there is none. */
+static struct udevice *get_uclass_device(enum uclass_id id, int index)
+{
+    struct uclass *uc;
+    struct udevice *dev;
+
+    if (uclass_get(id, &uc))
+        return NULL;
+
+    uclass_foreach_dev(dev, uc)
+        if (index-- == 0)
+            return dev;
+
+    return NULL;
+}
+
+int uboot_wrapper_ensure_mmc(void)
+{
+#ifdef CONFIG_DM_MMC
+    if (current_ctx->mmc_initialised)
+        return 0;
+
+    // Initialize the MMC system.
+    probe_uclass_devices(UCLASS_MMC);
+    int phase = uboot_profile_begin(&current_ctx->profile, "mmc_initialize");
+    int ret = mmc_initialize(NULL);
+    uboot_profile_end(&current_ctx->profile, phase);
+    if (0 != ret)
+        return ret;
+#endif
+
+    current_ctx->mmc_initialised = true;
+    return 0;
+}
+
+int uboot_wrapper_ensure_eth(void)
+{
+#ifdef CONFIG_NET
+    if (current_ctx->eth_initialised)
+        return 0;
+
+    // Initialize the ethernet system.
+    probe_uclass_devices(UCLASS_ETH);
+	puts("Net:   ");
+    int phase = uboot_profile_begin(&current_ctx->profile, "eth_initialize");
+	eth_initialize();
+    uboot_profile_end(&current_ctx->profile, phase);
+#ifdef CONFIG_RESET_PHY_R
+	debug("Reset Ethernet PHY\n");
+	reset_phy();
+#endif
+#endif
+
+    current_ctx->eth_initialised = true;
+    return 0;
+}
+
+static bool command_matches(const char *cmd, const char *const *prefixes, int count)
+{
+    for (int i = 0; i < count; i++)
+        if (!strncmp(cmd, prefixes[i], strlen(prefixes[i])))
+            return true;
+
+    return false;
+}
+
+/* Whether a word of the command's arguments (up to the end of the command)
+ * is the given interface name. */
+static bool command_has_interface(const char *cmd, const char *if_typename)
+{
+    size_t length = strlen(if_typename);
+
+    // Skip the command name.
+    cmd += strcspn(cmd, " \t;");
+    while (*cmd == ' ' || *cmd == '\t') {
+        cmd += strspn(cmd, " \t");
+        if (!strncmp(cmd, if_typename, length) && strchr(" \t;", cmd[length]))
+            return true;
+        cmd += strcspn(cmd, " \t;");
+    }
+
+    return false;
+}
+
+int uboot_init_step(void)
+{
+    // Fail immediately if library not initialised.
+    if (!uboot_wrapper_is_initialised())
+        return -1;
+
+    while (current_ctx->init_step_uclass < ARRAY_SIZE(init_step_uclasses)) {
+        enum uclass_id id = init_step_uclasses[current_ctx->init_step_uclass];
+        struct udevice *dev = get_uclass_device(id, current_ctx->init_step_device);
+
+        if (dev != NULL) {
+            current_ctx->init_step_device++;
+            if (device_active(dev))
+                continue;
+            probe_device(dev);
+            return 1;
+        }
+
+        // All devices of the uclass are probed, complete its initialisation.
+        int ret = (id == UCLASS_ETH) ?
+            uboot_wrapper_ensure_eth() : uboot_wrapper_ensure_mmc();
+        if (ret)
+            return ret;
+
+        current_ctx->init_step_uclass++;
+        current_ctx->init_step_device = 0;
+    }
+
+    return 0;
+}
+
+int uboot_wrapper_ensure_for_command(const char *cmd)
+{
+    int ret = 0;
+
+    // Check the first word of each command in the command string.
+    while (ret == 0 && cmd != NULL) {
+        while (*cmd == ' ' || *cmd == '\t' || *cmd == ';')
+            cmd++;
+
+        if (command_matches(cmd, mmc_command_prefixes, ARRAY_SIZE(mmc_command_prefixes)))
+            ret = uboot_wrapper_ensure_mmc();
+        else if (command_matches(cmd, blk_command_prefixes, ARRAY_SIZE(blk_command_prefixes)))
+            ret = command_has_interface(cmd, "mmc") ? uboot_wrapper_ensure_mmc() : 0;
+        else if (command_matches(cmd, eth_command_prefixes, ARRAY_SIZE(eth_command_prefixes)))
+            ret = uboot_wrapper_ensure_eth();
+
+        cmd = strchr(cmd, ';');
+    }
+
+    return ret;
+}
+
+struct uboot_profile *uboot_wrapper_get_profile(void)
+{
+    return &current_ctx->profile;
+}
 
-int initialise_uboot_wrapper(char* fdt_blob)
+struct uboot_ctx *uboot_wrapper_get_ctx(void)
 {
-    // Start the monotonic timer.
-    initialise_and_start_timer();
+    return current_ctx;
+}
 
-    // Return immediately if already initialised (nothing to do).
-    if (library_initialised) return 0;
+struct uboot_alias **uboot_wrapper_get_aliases(void)
+{
+    return (current_ctx != NULL) ? &current_ctx->aliases : NULL;
+}
 
-    // Set up the driver data.
-    initialise_driver_data();
+void uboot_wrapper_select(struct uboot_ctx *ctx)
+{
+    current_ctx = ctx;
+    gd = (ctx != NULL) ? ctx->gd : NULL;
+    sel4_dma_initialise((ctx != NULL) ? &ctx->dma_manager : NULL);
+    uboot_arena_select((ctx != NULL) ? &ctx->arena : NULL);
+}
 
-    // Allocation of global_data.
-    gd = malloc(sizeof(gd_t));
-    if (gd == NULL)
+int initialise_uboot_wrapper(struct uboot_ctx *ctx, char* fdt_blob)
+{
+    // Select the context and return if already initialised (nothing to do).
+    if (ctx->initialised) {
+        uboot_wrapper_select(ctx);
+        return 0;
+    }
+
+#if UBOOT_LIVE_TREE
+    // The generated live tree is a single static tree, to which the driver
+    // model of only one context may be bound.
+    if (ctx_count > 0) {
+        UBOOT_LOGE("Only one context may use the generated live tree");
+        return -EBUSY;
+    }
+#endif
+
+    // Start the monotonic timer, shared by all contexts.
+    if (ctx_count == 0)
+        initialise_and_start_timer();
+
+    struct uboot_ctx *previous_ctx = current_ctx;
+#if UBOOT_HAVE_TIMER
+    ctx->init_start_us = timer_get_us();
+#endif
+    ctx->mmc_initialised = false;
+    ctx->eth_initialised = false;
+    ctx->init_step_uclass = 0;
+    ctx->init_step_device = 0;
+    ctx->usb_start_profiled = false;
+    ctx->aliases = NULL;
+
+    // Allocation of global_data and the arena for the live tree and driver
+    // model structures.
+    ctx->gd = malloc(sizeof(gd_t));
+    if (ctx->gd == NULL)
         return -ENOMEM;
+    if (uboot_arena_create(&ctx->arena) != 0) {
+        free(ctx->gd);
+        ctx->gd = NULL;
+        return -ENOMEM;
+    }
+    uboot_wrapper_select(ctx);
 
     // Initialisation of (unused sections of the) global_data.
     gd->bd = NULL;
@@ -125,9 +369,22 @@ int initialise_uboot_wrapper(char* fdt_blob)
 	gd->fdt_size = fdt_totalsize(fdt_blob);
 	gd->fdt_src = FDTSRC_EMBED;
 
-    // Build the live tree from the FDT.
+    // Use the live tree generated at build time if built for it, otherwise
+    // build the live tree from the FDT.
+    int ret;
+    int phase;
+    uboot_arena_set_active(&ctx->arena, true);
+#if UBOOT_LIVE_TREE
+    gd->of_root = uboot_live_tree;
+    phase = uboot_profile_begin(&ctx->profile, "of_alias_scan");
+    ret = of_alias_scan();
+#else
     gd->of_root = NULL;
-    int ret = of_live_build(gd->fdt_blob, (struct device_node **)gd_of_root_ptr());
+    phase = uboot_profile_begin(&ctx->profile, "of_live_build");
+    ret = of_live_build(gd->fdt_blob, (struct device_node **)gd_of_root_ptr());
+#endif
+    uboot_profile_end(&ctx->profile, phase);
+    uboot_arena_set_active(&ctx->arena, false);
     if (0 != ret)
         goto error;
 
@@ -139,77 +396,169 @@ int initialise_uboot_wrapper(char* fdt_blob)
 	gd->env_valid = ENV_INVALID;
 	gd->env_has_init = 0;
 	gd->env_load_prio = 0;
-    env_relocate();
-
-    // Initialise the stdio files / devices and the (stubbed) cosole.
-    ret = stdio_init();
-    if (0 != ret)
-        goto error;
-    ret = console_init_r();
-    if (0 != ret)
-        goto error;
+    if (ctx_count == 0) {
+        phase = uboot_profile_begin(&ctx->profile, "env_relocate");
+        env_relocate();
+        uboot_profile_end(&ctx->profile, phase);
+    } else {
+        // The environment is held in U-Boot's global hash table, already
+        // set up by the first context, which must not be reset.
+        gd->flags |= GD_FLG_ENV_READY | GD_FLG_ENV_DEFAULT;
+    }
+
+    // Initialise the stdio files / devices and the (stubbed) cosole. These
+    // are also global to U-Boot, so only initialised by the first context.
+    if (ctx_count == 0) {
+        phase = uboot_profile_begin(&ctx->profile, "stdio_init");
+        ret = stdio_init();
+        if (0 == ret)
+            ret = console_init_r();
+        uboot_profile_end(&ctx->profile, phase);
+        if (0 != ret)
+            goto error;
+    }
 
     // Scan the device tree for compatible drivers.
+#if UBOOT_HAVE_TIMER
+    unsigned long bind_start = timer_get_us();
+#endif
+    phase = uboot_profile_begin(&ctx->profile, "dm_init_and_scan");
+    uboot_arena_set_active(&ctx->arena, true);
     ret = dm_init_and_scan(false);
+    uboot_arena_set_active(&ctx->arena, false);
+    uboot_profile_end(&ctx->profile, phase);
     if (0 != ret)
         goto error;
-
-#ifdef CONFIG_DM_MMC
-    // Initialize the MMC system.
-    ret = mmc_initialize(NULL);
-    if (0 != ret)
-        goto error;
-#endif
-
-#ifdef CONFIG_NET
-    // Initialize the ethernet system.
-	puts("Net:   ");
-	eth_initialize();
-#ifdef CONFIG_RESET_PHY_R
-	debug("Reset Ethernet PHY\n");
-	reset_phy();
-#endif
+#if UBOOT_HAVE_TIMER
+    UBOOT_LOGI("Bound devices in %lu us", timer_get_us() - bind_start);
 #endif
+    uboot_arena_report(&ctx->arena);
+
+    // Interpose the block cache beneath the blk uclass.
+    if (ctx_count == 0) {
+        ret = uboot_blk_cache_init();
+        if (0 != ret)
+            goto error;
+    }
+
+    // Probe the MMC and Ethernet devices, unless in lazy mode in which case
+    // these are probed on first use.
+    if (!UBOOT_LAZY_PROBE) {
+        ret = uboot_wrapper_ensure_mmc();
+        if (0 != ret)
+            goto error;
+        uboot_wrapper_ensure_eth();
+    }
 
     // Success.
-    library_initialised = true;
+    ctx->initialised = true;
+    ctx_count++;
     return 0;
 
 error:
-    // Failed to initialise library, clean up and return error code.
-    free(gd);
-    gd = NULL;
+    // Failed to initialise library, clean up and return error code. State
+    // shared by all contexts is released if this was to be the first.
+    if (ctx_count == 0) {
+        uboot_blk_cache_shutdown();
+        shutdown_timer();
+    }
+    stdio_remove_owned(ctx->gd);
+    uboot_arena_release(&ctx->arena);
+    ctx->aliases = NULL;
+    free(ctx->gd);
+    ctx->gd = NULL;
+    uboot_wrapper_select(previous_ctx);
     return -1;
 }
 
+bool uboot_wrapper_is_initialised(void)
+{
+    return current_ctx != NULL && current_ctx->initialised;
+}
+
 int run_uboot_command(char* cmd)
 {
     // Fail immediately if library not initialised.
-    if (!library_initialised)
+    if (!uboot_wrapper_is_initialised())
         return -1;
 
     log_info("--- running command '%s' ---", cmd);
 
-    // Perform the command.
-    int ret = run_command(cmd, CMD_FLAG_ENV);
+    // Probe any devices required by the command not yet probed.
+    uboot_wrapper_ensure_for_command(cmd);
+
+    // Starting USB is part of bringing up the devices, so the first start is
+    // profiled with initialisation. Later starts are not, so that they do
+    // not fill the profile.
+    int phase = -1;
+    if (!current_ctx->usb_start_profiled && !strcmp(cmd, "usb start")) {
+        phase = uboot_profile_begin(&current_ctx->profile, "usb start");
+        current_ctx->usb_start_profiled = true;
+    }
+
+    // Perform the command, directly if the command line parser is not needed.
+    // Commands are only timed when statistics are kept, as not all
+    // platforms have a timer.
+#if UBOOT_COMMAND_STATS
+    unsigned long start = timer_get_us();
+#endif
+    int ret = uboot_command_run_direct(cmd, CMD_FLAG_ENV);
+    if (ret == -EAGAIN)
+        ret = run_command(cmd, CMD_FLAG_ENV);
+
+    uboot_profile_end(&current_ctx->profile, phase);
+#if UBOOT_COMMAND_STATS
+    uboot_command_stats_record(cmd, timer_get_us() - start, ret);
+#endif
 
     log_info("--- command '%s' completed with return code %i ---", cmd, ret);
 
     return ret;
 }
 
-void shutdown_uboot_wrapper(void)
+void shutdown_uboot_wrapper(struct uboot_ctx *ctx)
 {
-    // Return immediately if library not initialised (nothing to do).
-    if (!library_initialised)
+    // Return immediately if context not initialised (nothing to do).
+    if (!ctx->initialised)
         return;
 
-    // Shutdown the monotonic timer.
-    shutdown_timer();
-
-    // Delete persistant state.
-    free(gd);
-    gd = NULL;
+    // Close the handles opened through the context, whose devices are about
+    // to be released. Files are closed first as they write through the
+    // block devices.
+    struct uboot_ctx *previous_ctx = (current_ctx != ctx) ? current_ctx : NULL;
+    uboot_wrapper_select(ctx);
+    uboot_fs_close_all(ctx);
+    uboot_blk_close_all(ctx);
+
+    ctx->initialised = false;
+    ctx_count--;
+
+    if (ctx_count == 0) {
+        // Release the block cache.
+        uboot_blk_cache_shutdown();
+
+        // Release the index used to bind devices, shared by all contexts.
+        uboot_bind_index_release();
+
+        // Shutdown the monotonic timer.
+        shutdown_timer();
+    } else {
+        // The block cache outlives this context, so must not hold blocks
+        // of (or refer to) its devices.
+        uboot_blk_cache_purge();
+    }
+
+    // U-Boot's stdio device list outlives the context, so must not hold
+    // the devices registered by its drivers.
+    stdio_remove_owned(ctx->gd);
+
+    // Delete persistant state, including the live tree and driver model
+    // structures held in the arena.
+    uboot_arena_release(&ctx->arena);
+    ctx->aliases = NULL;
+    free(ctx->gd);
+    ctx->gd = NULL;
+    uboot_wrapper_select(previous_ctx);
 
     return;
 }
@@ -222,7 +571,7 @@ unsigned long uboot_monotonic_timer_get_us(void)
 int uboot_stdin_tstc(void)
 {
     // Return immediately if library not initialised .
-    if (!library_initialised)
+    if (!uboot_wrapper_is_initialised())
         return -1;
 
     if (NULL == stdio_devices[stdin])
@@ -234,7 +583,7 @@ int uboot_stdin_tstc(void)
 int uboot_stdin_getc(void)
 {
     // Return immediately if library not initialised .
-    if (!library_initialised)
+    if (!uboot_wrapper_is_initialised())
         return -1;
 
     if (NULL == stdio_devices[stdin])
@@ -243,20 +592,43 @@ int uboot_stdin_getc(void)
     return stdio_devices[stdin]->getc(stdio_devices[stdin]);
 }
 
+int uboot_input_read(char *events, int max)
+{
+    // Return immediately if library not initialised .
+    if (!uboot_wrapper_is_initialised())
+        return -1;
+
+    struct stdio_dev *dev = stdio_devices[stdin];
+    if (NULL == dev)
+        return 0;
+
+    // Each tstc may poll the device, so collect everything the device has
+    // buffered in one pass rather than one character per call.
+    int count = 0;
+    while (count < max && dev->tstc(dev) > 0)
+        events[count++] = dev->getc(dev);
+
+    return count;
+}
+
 #ifdef CONFIG_DM_ETH
 
 int uboot_eth_init(void)
 {
     // Return immediately if library not initialised .
-    if (!library_initialised)
+    if (!uboot_wrapper_is_initialised())
         return -1;
 
+    int ret = uboot_wrapper_ensure_eth();
+    if (ret)
+        return ret;
+
     return eth_init();
 }
 void uboot_eth_halt(void)
 {
     // Return immediately if library not initialised .
-    if (!library_initialised)
+    if (!uboot_wrapper_is_initialised())
         return;
 
     eth_halt();
@@ -265,7 +637,7 @@ void uboot_eth_halt(void)
 int uboot_eth_send(unsigned char *packet, int length)
 {
     // Return immediately if library not initialised .
-    if (!library_initialised)
+    if (!uboot_wrapper_is_initialised())
         return -1;
 
 	struct udevice *current;
@@ -283,10 +655,43 @@ int uboot_eth_send(unsigned char *packet, int length)
 	return ret;
 }
 
+int uboot_eth_send_batch(unsigned char **packets, int *lengths, int count)
+{
+    // Return immediately if library not initialised .
+    if (!uboot_wrapper_is_initialised())
+        return -1;
+
+	struct udevice *current;
+
+	current = eth_get_dev();
+	if (!current)
+		return -ENODEV;
+
+	if (!eth_is_active(current))
+		return -EINVAL;
+
+    // The drivers have no operation sending several packets, so each is
+    // passed to the send operation in turn.
+    const struct eth_ops *ops = eth_get_ops(current);
+    int sent;
+
+    for (sent = 0; sent < count; sent++) {
+        int ret = ops->send(current, packets[sent], lengths[sent]);
+        if (ret < 0) {
+            // Report the error only if no packets have been sent.
+            if (sent == 0)
+                return ret;
+            break;
+        }
+    }
+
+	return sent;
+}
+
 int uboot_eth_receive(unsigned char **packet)
 {
     // Return immediately if library not initialised .
-    if (!library_initialised)
+    if (!uboot_wrapper_is_initialised())
         return -1;
 
 	struct udevice *current;
@@ -312,7 +717,7 @@ int uboot_eth_receive(unsigned char **packet)
 int uboot_eth_free_packet(unsigned char **packet)
 {
     // Return immediately if library not initialised .
-    if (!library_initialised)
+    if (!uboot_wrapper_is_initialised())
         return -1;
 
 	struct udevice *current;
@@ -328,10 +733,103 @@ int uboot_eth_free_packet(unsigned char **packet)
 	return ret;
 }
 
+// Buffers holding packets returned by uboot_eth_receive_burst until they are
+// handed back through uboot_eth_release_burst.
+static uchar eth_rx_burst_buffers[CONFIG_SYS_RX_ETH_BUFFER][PKTSIZE_ALIGN]
+    __aligned(PKTALIGN);
+static bool eth_rx_burst_in_use[CONFIG_SYS_RX_ETH_BUFFER];
+
+int uboot_eth_receive_burst(unsigned char **packets, int *lengths, int max)
+{
+    // Return immediately if library not initialised .
+    if (!uboot_wrapper_is_initialised())
+        return -1;
+
+	struct udevice *current;
+
+	current = eth_get_dev();
+	if (!current)
+		return -ENODEV;
+
+	if (!eth_is_active(current))
+		return -EINVAL;
+
+    const struct eth_ops *ops = eth_get_ops(current);
+    int flags = ETH_RECV_CHECK_DEVICE;
+    int count = 0;
+    int slot = 0;
+
+    while (count < max) {
+        // Find a free buffer to hold the next packet.
+        while (slot < CONFIG_SYS_RX_ETH_BUFFER && eth_rx_burst_in_use[slot])
+            slot++;
+        if (slot == CONFIG_SYS_RX_ETH_BUFFER) {
+            // Distinguish every buffer being held from no packet waiting.
+            if (count == 0)
+                return -EAGAIN;
+            break;
+        }
+
+        uchar *packet;
+        int ret = ops->recv(current, flags, &packet);
+        flags = 0;
+
+        if (ret == 0 && ops->free_pkt)
+            ops->free_pkt(current, packet, ret);
+
+        if (ret == -EAGAIN || ret == 0)
+            break;
+
+        if (ret < 0) {
+            // Report the error only if no packets have been received.
+            if (count == 0)
+                return ret;
+            break;
+        }
+
+        // The driver's buffer is only valid until the next call to recv, so
+        // the packet is moved to a burst buffer and the driver's buffer (and
+        // its receive descriptor) returned immediately.
+        memcpy(eth_rx_burst_buffers[slot], packet, ret);
+        if (ops->free_pkt)
+            ops->free_pkt(current, packet, ret);
+
+        eth_rx_burst_in_use[slot] = true;
+        packets[count] = eth_rx_burst_buffers[slot];
+        lengths[count] = ret;
+        count++;
+    }
+
+	return count;
+}
+
+void uboot_eth_release_burst(unsigned char **packets, int count)
+{
+    for (int i = 0; i < count; i++) {
+        // Ignore any pointer that is not the start of a held burst buffer.
+        ptrdiff_t offset = packets[i] - &eth_rx_burst_buffers[0][0];
+        if (offset < 0 || offset % PKTSIZE_ALIGN != 0 ||
+            offset / PKTSIZE_ALIGN >= CONFIG_SYS_RX_ETH_BUFFER) {
+            UBOOT_LOGW("Released packet %p is not a burst buffer", packets[i]);
+            continue;
+        }
+
+        int slot = offset / PKTSIZE_ALIGN;
+        if (!eth_rx_burst_in_use[slot]) {
+            UBOOT_LOGW("Released packet %p is not held", packets[i]);
+            continue;
+        }
+        eth_rx_burst_in_use[slot] = false;
+    }
+}
+
 unsigned char *uboot_eth_get_ethaddr(void)
 {
     // Return immediately if library not initialised .
-    if (!library_initialised)
+    if (!uboot_wrapper_is_initialised())
+        return 0;
+
+    if (uboot_wrapper_ensure_eth())
         return 0;
 
     return eth_get_ethaddr();
@@ -342,8 +840,11 @@ unsigned char *uboot_eth_get_ethaddr(void)
 int uboot_eth_init(void) { return 0; }
 void uboot_eth_halt(void) {}
 int uboot_eth_send(unsigned char *packet, int length) { return 0; }
+int uboot_eth_send_batch(unsigned char **packets, int *lengths, int count) { return 0; }
 int uboot_eth_receive(unsigned char **packet) { return 0; }
 int uboot_eth_free_packet(unsigned char **packet) { return 0; }
+int uboot_eth_receive_burst(unsigned char **packets, int *lengths, int max) { return 0; }
+void uboot_eth_release_burst(unsigned char **packets, int count) {}
 unsigned char *uboot_eth_get_ethaddr(void) { return 0; }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,158 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* In-memory block devices for the block cache tests, included after
+ * uboot_blk_cache.c. The devices are driven by the driver the cache
+ * interposes on, which records each transfer made to a device. Tests
+ * advance the time seen by the cache through fake_time_us. */
+
+#pragma once
+
+#define FAKE_BLOCKS 1024
+#define FAKE_BLOCK_SIZE 512
+#define FAKE_MAX_TRANSFERS 256
+
+struct fake_transfer_t {
+    char op;    // 'r', 'w' or 'e'
+    struct udevice *dev;
+    lbaint_t start;
+    lbaint_t blkcnt;
+};
+
+struct fake_device_t {
+    struct udevice dev;
+    struct blk_desc desc;
+    char data[FAKE_BLOCKS * FAKE_BLOCK_SIZE];
+};
+
+static struct fake_device_t fake_devices[2];
+
+static struct fake_transfer_t fake_transfers[FAKE_MAX_TRANSFERS];
+static int fake_transfer_count;
+
+// A block of either device at which transfers fail.
+static lbaint_t fake_failing_block = (lbaint_t)-1;
+
+static unsigned long fake_time_us;
+
+static struct fake_device_t *fake_device(struct udevice *dev)
+{
+    return container_of(dev, struct fake_device_t, dev);
+}
+
+static unsigned long fake_transfer(char op, struct udevice *dev, lbaint_t start,
+    lbaint_t blkcnt)
+{
+    if (fake_transfer_count < FAKE_MAX_TRANSFERS)
+        fake_transfers[fake_transfer_count++] = (struct fake_transfer_t){ op, dev, start, blkcnt };
+
+    if (fake_failing_block >= start && fake_failing_block - start < blkcnt)
+        return fake_failing_block - start;
+
+    return blkcnt;
+}
+
+static unsigned long fake_read(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+    void *buffer)
+{
+    unsigned long done = fake_transfer('r', dev, start, blkcnt);
+    memcpy(buffer, fake_device(dev)->data + start * FAKE_BLOCK_SIZE, done * FAKE_BLOCK_SIZE);
+    return done;
+}
+
+static unsigned long fake_write(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+    const void *buffer)
+{
+    unsigned long done = fake_transfer('w', dev, start, blkcnt);
+    memcpy(fake_device(dev)->data + start * FAKE_BLOCK_SIZE, buffer, done * FAKE_BLOCK_SIZE);
+    return done;
+}
+
+static unsigned long fake_erase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
+{
+    unsigned long done = fake_transfer('e', dev, start, blkcnt);
+    memset(fake_device(dev)->data + start * FAKE_BLOCK_SIZE, 0, done * FAKE_BLOCK_SIZE);
+    return done;
+}
+
+static int fake_select_hwpart(struct udevice *dev, int hwpart)
+{
+    fake_device(dev)->desc.hwpart = hwpart;
+    return 0;
+}
+
+static const struct blk_ops fake_ops = {
+    .read = fake_read,
+    .write = fake_write,
+    .erase = fake_erase,
+    .select_hwpart = fake_select_hwpart,
+};
+
+static struct driver fake_driver = {
+    .name = BLK_CACHE_DRIVER_NAME,
+    .ops = &fake_ops,
+};
+
+struct driver *lists_driver_lookup_name(const char *name)
+{
+    return !strcmp(name, fake_driver.name) ? &fake_driver : NULL;
+}
+
+unsigned long timer_get_us(void) { return fake_time_us; }
+bool uboot_wrapper_is_initialised(void) { return true; }
+
+/* Set up the devices, with the given block size for the second, and the
+ * cache. The first device has a block size of 512 bytes. */
+static void fake_setup(unsigned long second_blksz)
+{
+    for (int i = 0; i < 2; i++) {
+        struct fake_device_t *fake = &fake_devices[i];
+        fake->dev.uclass_plat = &fake->desc;
+        fake->desc.blksz = (i == 0) ? FAKE_BLOCK_SIZE : second_blksz;
+        fake->desc.lba = FAKE_BLOCKS * FAKE_BLOCK_SIZE / fake->desc.blksz;
+        fake->desc.hwpart = 0;
+        fake->desc.bdev = &fake->dev;
+        for (int block = 0; block < FAKE_BLOCKS; block++)
+            memset(fake->data + block * FAKE_BLOCK_SIZE, block & 0xff, FAKE_BLOCK_SIZE);
+    }
+
+    fake_transfer_count = 0;
+    fake_failing_block = (lbaint_t)-1;
+    fake_time_us = 0;
+    uboot_blk_cache_init();
+}
+
+/* Read or write through the operations installed by the cache. */
+static unsigned long fake_cached_read(int device, lbaint_t start, lbaint_t blkcnt,
+    void *buffer)
+{
+    const struct blk_ops *ops = fake_driver.ops;
+    return ops->read(&fake_devices[device].dev, start, blkcnt, buffer);
+}
+
+static unsigned long fake_cached_write(int device, lbaint_t start, lbaint_t blkcnt,
+    const void *buffer)
+{
+    const struct blk_ops *ops = fake_driver.ops;
+    return ops->write(&fake_devices[device].dev, start, blkcnt, buffer);
+}
+
+static bool fake_transfer_is(int index, char op, lbaint_t start, lbaint_t blkcnt)
+{
+    return index < fake_transfer_count && fake_transfers[index].op == op &&
+        fake_transfers[index].start == start && fake_transfers[index].blkcnt == blkcnt;
+}
+
+/* Read a block through the cache and return the number of transfers made
+ * to the device in doing so. */
+static int fake_transfers_for_read(int device, lbaint_t block)
+{
+    char buffer[FAKE_BLOCK_SIZE];
+    int before = fake_transfer_count;
+
+    fake_cached_read(device, block, 1, buffer);
+    return fake_transfer_count - before;
+}
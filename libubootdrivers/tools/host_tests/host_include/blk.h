@@ -0,0 +1,46 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host replacement for U-Boot's block device header, with the block
+ * descriptor and operations reduced to the fields used by the library.
+ * Tests provide the routines declared. */
+
+#pragma once
+
+#include <inttypes.h>
+
+typedef uint64_t lbaint_t;
+#define LBAF "%" PRIx64
+
+#define DEV_TYPE_UNKNOWN    0xff
+#define DEV_TYPE_HARDDISK   0x00
+
+struct udevice;
+
+struct blk_desc {
+    int type;
+    int hwpart;
+    unsigned long blksz;
+    lbaint_t lba;
+    struct udevice *bdev;
+};
+
+struct blk_ops {
+    unsigned long (*read)(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+        void *buffer);
+    unsigned long (*write)(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
+        const void *buffer);
+    unsigned long (*erase)(struct udevice *dev, lbaint_t start, lbaint_t blkcnt);
+    int (*select_hwpart)(struct udevice *dev, int hwpart);
+};
+
+unsigned long blk_dread(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+    void *buffer);
+
+unsigned long blk_dwrite(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+    const void *buffer);
+
+struct blk_desc *blk_get_devnum_by_typename(const char *if_typename, int devnum);
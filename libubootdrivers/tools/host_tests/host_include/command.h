@@ -0,0 +1,31 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host replacement for U-Boot's command header, with the command table
+ * entry reduced to the fields used by the library. Tests provide the
+ * routines declared. */
+
+#pragma once
+
+#define CMD_FLAG_REPEAT     0x0001
+#define CMD_FLAG_BOOTD      0x0002
+#define CMD_FLAG_ENV        0x0004
+
+enum command_ret_t {
+    CMD_RET_SUCCESS,
+    CMD_RET_FAILURE,
+    CMD_RET_USAGE = -1,
+};
+
+struct cmd_tbl {
+    char *name;
+    int maxargs;
+    int (*cmd)(struct cmd_tbl *cmd, int flag, int argc, char *const argv[]);
+};
+
+struct cmd_tbl *find_cmd(const char *cmd);
+
+int cmd_usage(const struct cmd_tbl *cmdtp);
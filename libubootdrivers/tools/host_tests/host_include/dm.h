@@ -0,0 +1,25 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host replacement for U-Boot's driver model header, with devices and
+ * drivers reduced to the fields used by the library. */
+
+#pragma once
+
+struct udevice {
+    // The device's uclass platform data, e.g. its struct blk_desc.
+    void *uclass_plat;
+};
+
+struct driver {
+    char *name;
+    const void *ops;
+};
+
+static inline void *dev_get_uclass_plat(const struct udevice *dev)
+{
+    return dev->uclass_plat;
+}
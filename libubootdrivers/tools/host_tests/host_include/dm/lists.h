@@ -0,0 +1,12 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host replacement for U-Boot's driver list header. Tests provide the
+ * routines declared. */
+
+#pragma once
+
+struct driver *lists_driver_lookup_name(const char *name);
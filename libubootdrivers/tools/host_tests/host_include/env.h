@@ -0,0 +1,12 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host replacement for U-Boot's environment header. Tests provide the
+ * routines used by the source under test. */
+
+#pragma once
+
+unsigned long env_get_hex(const char *varname, unsigned long default_val);
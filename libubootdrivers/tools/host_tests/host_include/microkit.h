@@ -0,0 +1,19 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host replacement for the Microkit header, providing the standard types
+ * the library's headers expect it to bring in. Tests provide the routines
+ * declared. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int microkit_channel;
+
+void microkit_notify(microkit_channel ch);
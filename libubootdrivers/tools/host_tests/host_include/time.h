@@ -0,0 +1,14 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host replacement for U-Boot's timer header, which shares its name with
+ * the C library's. Tests provide the routines declared. */
+
+#pragma once
+
+#include_next <time.h>
+
+unsigned long timer_get_us(void);
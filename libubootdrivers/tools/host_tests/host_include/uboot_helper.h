@@ -0,0 +1,43 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host replacement for the library's base U-Boot configuration, providing
+ * only the definitions used by the library sources under test. Log messages
+ * are discarded, as tests provoke errors deliberately. */
+
+#pragma once
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONFIG_SYS_MAXARGS              64
+#define CONFIG_SYS_CBSIZE               256
+
+typedef unsigned long ulong;
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+#define min_t(type, x, y) ({ \
+    type min_x = (x); \
+    type min_y = (y); \
+    min_x < min_y ? min_x : min_y; \
+})
+
+#define simple_strtoul strtoul
+#define simple_strtoull strtoull
+
+#define UBOOT_LOGV(...) ({})
+#define UBOOT_LOGD(...) ({})
+#define UBOOT_LOGI(...) ({})
+#define UBOOT_LOGW(...) ({})
+#define UBOOT_LOGE(...) ({})
+#define UBOOT_LOGF(...) ({})
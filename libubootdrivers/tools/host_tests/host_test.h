@@ -0,0 +1,41 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Checks used by the host tests. A failed check is reported and counted,
+ * and the test continues; the test's main returns host_test_result(). */
+
+#pragma once
+
+#include <stdio.h>
+
+static int host_test_failures;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        host_test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+    long long actual_value = (long long)(actual); \
+    long long expected_value = (long long)(expected); \
+    if (actual_value != expected_value) { \
+        fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", \
+            __FILE__, __LINE__, #actual, #expected, actual_value, expected_value); \
+        host_test_failures++; \
+    } \
+} while (0)
+
+static inline int host_test_result(const char *name)
+{
+    if (host_test_failures)
+        printf("%s: %d checks failed\n", name, host_test_failures);
+    else
+        printf("%s: passed\n", name);
+
+    return host_test_failures ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host test of the initialisation arena (uboot_arena.c): placement and
+ * alignment of allocations, fall back to the heap when inactive or full,
+ * realloc of arena memory, and freeing memory of other contexts' arenas.
+ * Built with a 4 KiB arena. */
+
+#include "uboot_arena.c"
+#include "host_test.h"
+
+/* Without the linker's --wrap option the C library's routines are called
+ * directly. */
+void *__real_malloc(size_t size) { return malloc(size); }
+void *__real_calloc(size_t nmemb, size_t size) { return calloc(nmemb, size); }
+void *__real_realloc(void *ptr, size_t size) { return realloc(ptr, size); }
+void *__real_memalign(size_t align, size_t size) { return aligned_alloc(align, size); }
+void __real_free(void *ptr) { free(ptr); }
+
+static bool in_arena(struct uboot_arena *arena, void *ptr)
+{
+    return (char *)ptr >= arena->base && (char *)ptr < arena->base + arena->size;
+}
+
+static void test_placement(void)
+{
+    struct uboot_arena arena;
+
+    CHECK_EQ(uboot_arena_create(&arena), 0);
+    uboot_arena_select(&arena);
+
+    // Not active, so allocations come from the heap.
+    void *heap = __wrap_malloc(16);
+    CHECK(heap != NULL && !in_arena(&arena, heap));
+    __wrap_free(heap);
+
+    uboot_arena_set_active(&arena, true);
+    char *a = __wrap_malloc(10);
+    char *b = __wrap_calloc(3, 7);
+    char *c = __wrap_memalign(64, 8);
+    CHECK(in_arena(&arena, a) && in_arena(&arena, b) && in_arena(&arena, c));
+    CHECK_EQ((uintptr_t)a % ARENA_ALIGN, 0);
+    CHECK_EQ((uintptr_t)b % ARENA_ALIGN, 0);
+    CHECK_EQ((uintptr_t)c % 64, 0);
+    CHECK(b >= a + 10 + ARENA_HEADER);
+    CHECK(c >= b + 21 + ARENA_HEADER);
+    CHECK_EQ(arena_alloc_size(a), 10);
+    CHECK_EQ(arena_alloc_size(b), 21);
+    CHECK_EQ(b[0] | b[20], 0);
+
+    // Freeing arena memory has no effect.
+    __wrap_free(a);
+    CHECK((char *)__wrap_malloc(1) > c);
+
+    // Allocations that do not fit come from the heap and are counted.
+    void *large = __wrap_malloc(8192);
+    CHECK(large != NULL && !in_arena(&arena, large));
+    CHECK_EQ(arena.overflow, 8192);
+    __wrap_free(large);
+
+    CHECK(__wrap_calloc(SIZE_MAX / 2, 4) == NULL);
+
+    uboot_arena_release(&arena);
+    CHECK(arena.base == NULL);
+    CHECK(current_arena == NULL && arenas == NULL);
+}
+
+static void test_suspend(void)
+{
+    struct uboot_arena arena;
+
+    uboot_arena_create(&arena);
+    uboot_arena_select(&arena);
+    uboot_arena_set_active(&arena, true);
+
+    bool active = uboot_arena_suspend();
+    CHECK(active);
+    void *heap = __wrap_malloc(16);
+    CHECK(!in_arena(&arena, heap));
+    __wrap_free(heap);
+
+    // Suspending again while suspended must not re-activate on resume.
+    bool nested = uboot_arena_suspend();
+    CHECK(!nested);
+    uboot_arena_resume(nested);
+    CHECK(!arena.active);
+
+    uboot_arena_resume(active);
+    CHECK(in_arena(&arena, __wrap_malloc(16)));
+
+    uboot_arena_release(&arena);
+}
+
+static void test_realloc(void)
+{
+    struct uboot_arena arena;
+
+    uboot_arena_create(&arena);
+    uboot_arena_select(&arena);
+    uboot_arena_set_active(&arena, true);
+
+    char *a = __wrap_malloc(8);
+    char *b = __wrap_malloc(8);
+    memset(a, 'a', 8);
+    memset(b, 'b', 8);
+
+    // Shrinking, or growing within the size requested, keeps the memory.
+    CHECK(__wrap_realloc(a, 4) == a);
+    CHECK(__wrap_realloc(a, 8) == a);
+
+    // Growing copies only the old allocation, leaving its neighbour intact
+    // and the remainder zeroed.
+    char *grown = __wrap_realloc(a, 32);
+    CHECK(grown != a && in_arena(&arena, grown));
+    CHECK(!memcmp(grown, "aaaaaaaa", 8));
+    CHECK_EQ(grown[8] | grown[31], 0);
+    CHECK(!memcmp(b, "bbbbbbbb", 8));
+
+    // With the arena full, arena memory is moved to the heap.
+    char *full = __wrap_realloc(b, 8192);
+    CHECK(full != NULL && !in_arena(&arena, full));
+    CHECK(!memcmp(full, "bbbbbbbb", 8));
+    __wrap_free(full);
+
+    // Heap memory is reallocated by the C library.
+    uboot_arena_set_active(&arena, false);
+    char *heap = __wrap_malloc(4);
+    memcpy(heap, "heap", 4);
+    heap = __wrap_realloc(heap, 4096);
+    CHECK(heap != NULL && !in_arena(&arena, heap) && !memcmp(heap, "heap", 4));
+    __wrap_free(heap);
+
+    uboot_arena_release(&arena);
+}
+
+static void test_contexts(void)
+{
+    struct uboot_arena first, second;
+
+    uboot_arena_create(&first);
+    uboot_arena_create(&second);
+
+    uboot_arena_select(&first);
+    uboot_arena_set_active(&first, true);
+    char *ptr = __wrap_malloc(8);
+    memcpy(ptr, "context", 8);
+    uboot_arena_set_active(&first, false);
+
+    // Memory of another context's arena is recognised when freed or
+    // reallocated while that context is not selected.
+    uboot_arena_select(&second);
+    uboot_arena_set_active(&second, true);
+    CHECK(find_arena(ptr) == &first);
+    __wrap_free(ptr);
+    char *moved = __wrap_realloc(ptr, 64);
+    CHECK(in_arena(&second, moved) && !memcmp(moved, "context", 8));
+
+    uboot_arena_release(&first);
+    CHECK(find_arena(moved) == &second);
+    CHECK(arenas == &second && second.next == NULL);
+    uboot_arena_release(&second);
+}
+
+int main(void)
+{
+    test_placement();
+    test_suspend();
+    test_realloc();
+    test_contexts();
+
+    return host_test_result("test_arena");
+}
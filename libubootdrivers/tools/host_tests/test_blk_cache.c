@@ -0,0 +1,179 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host test of the block cache (uboot_blk_cache.c) in its default
+ * write-through configuration: interposing on the block driver, hits and
+ * misses, merging of missing blocks into single reads, least recently used
+ * replacement, the bypass of large transfers and of devices with other
+ * block sizes, and keeping cached blocks consistent with writes, erases and
+ * switches of hardware partition. */
+
+#include "uboot_blk_cache.c"
+#include "host_test.h"
+#include "fake_blk_device.h"
+
+static bool block_holds(const char *data, char value)
+{
+    for (int i = 0; i < FAKE_BLOCK_SIZE; i++)
+        if (data[i] != value)
+            return false;
+
+    return true;
+}
+
+static void test_interpose(void)
+{
+    fake_setup(FAKE_BLOCK_SIZE);
+    CHECK(fake_driver.ops == &cached_ops);
+
+    // Initialising again must not interpose on the cache's own operations.
+    CHECK_EQ(uboot_blk_cache_init(), 0);
+    CHECK(device_ops == &fake_ops);
+
+    uboot_blk_cache_shutdown();
+    CHECK(fake_driver.ops == &fake_ops);
+}
+
+static void test_hits_and_misses(void)
+{
+    char buffer[8 * FAKE_BLOCK_SIZE];
+    struct uboot_blk_cache_stats stats;
+
+    fake_setup(4096);
+
+    CHECK_EQ(fake_transfers_for_read(0, 5), 1);
+    CHECK_EQ(fake_transfers_for_read(0, 5), 0);
+
+    // Only the blocks missing from the cache are read, each run of them as
+    // a single transfer.
+    fake_transfer_count = 0;
+    CHECK_EQ(fake_cached_read(0, 3, 6, buffer), 6);
+    CHECK_EQ(fake_transfer_count, 2);
+    CHECK(fake_transfer_is(0, 'r', 3, 2));
+    CHECK(fake_transfer_is(1, 'r', 6, 3));
+    for (int i = 0; i < 6; i++)
+        CHECK(block_holds(buffer + i * FAKE_BLOCK_SIZE, 3 + i));
+
+    CHECK_EQ(uboot_blk_cache_get_stats(&stats), 0);
+    CHECK_EQ(stats.hits, 2);
+    CHECK_EQ(stats.misses, 6);
+    CHECK_EQ(stats.blocks_cached, 6);
+    CHECK_EQ(stats.blocks_max, 16);
+
+    // Reads larger than a quarter of the cache are not added to it.
+    CHECK_EQ(fake_cached_read(0, 20, 5, buffer), 5);
+    CHECK_EQ(fake_transfers_for_read(0, 20), 1);
+
+    // Nor are blocks of devices with other block sizes.
+    CHECK_EQ(fake_transfers_for_read(1, 0), 1);
+    CHECK_EQ(fake_transfers_for_read(1, 0), 1);
+
+    uboot_blk_cache_shutdown();
+}
+
+static void test_lru_replacement(void)
+{
+    struct uboot_blk_cache_stats stats;
+
+    fake_setup(FAKE_BLOCK_SIZE);
+
+    for (int block = 0; block < 16; block++)
+        fake_transfers_for_read(0, block);
+
+    // Using block 0 again leaves block 1 as the least recently used, so it
+    // is replaced by the next block read.
+    CHECK_EQ(fake_transfers_for_read(0, 0), 0);
+    CHECK_EQ(fake_transfers_for_read(0, 16), 1);
+    CHECK_EQ(fake_transfers_for_read(0, 0), 0);
+    CHECK_EQ(fake_transfers_for_read(0, 2), 0);
+    CHECK_EQ(fake_transfers_for_read(0, 1), 1);
+
+    CHECK_EQ(uboot_blk_cache_get_stats(&stats), 0);
+    CHECK_EQ(stats.evictions, 2);
+    CHECK_EQ(stats.blocks_cached, 16);
+
+    uboot_blk_cache_invalidate();
+    CHECK_EQ(fake_transfers_for_read(0, 0), 1);
+
+    uboot_blk_cache_shutdown();
+}
+
+static void test_write_through(void)
+{
+    char buffer[2 * FAKE_BLOCK_SIZE];
+
+    fake_setup(FAKE_BLOCK_SIZE);
+
+    // Writes reach the device at once, updating cached copies.
+    fake_transfers_for_read(0, 0);
+    memset(buffer, 0xaa, sizeof(buffer));
+    fake_transfer_count = 0;
+    CHECK_EQ(fake_cached_write(0, 0, 1, buffer), 1);
+    CHECK_EQ(fake_transfer_count, 1);
+    CHECK(fake_transfer_is(0, 'w', 0, 1));
+    CHECK(block_holds(fake_devices[0].data, 0xaa));
+
+    memset(buffer, 0, sizeof(buffer));
+    fake_transfer_count = 0;
+    CHECK_EQ(fake_cached_read(0, 0, 1, buffer), 1);
+    CHECK_EQ(fake_transfer_count, 0);
+    CHECK(block_holds(buffer, 0xaa));
+
+    // Cached copies of blocks that failed to write are discarded.
+    fake_transfers_for_read(0, 40);
+    fake_transfers_for_read(0, 41);
+    fake_failing_block = 41;
+    memset(buffer, 0xbb, sizeof(buffer));
+    CHECK_EQ(fake_cached_write(0, 40, 2, buffer), 1);
+    fake_failing_block = (lbaint_t)-1;
+    CHECK_EQ(fake_transfers_for_read(0, 40), 0);
+    CHECK_EQ(fake_transfers_for_read(0, 41), 1);
+
+    // Erased blocks are discarded.
+    const struct blk_ops *ops = fake_driver.ops;
+    CHECK_EQ(ops->erase(&fake_devices[0].dev, 40, 1), 1);
+    fake_transfer_count = 0;
+    CHECK_EQ(fake_cached_read(0, 40, 1, buffer), 1);
+    CHECK_EQ(fake_transfer_count, 1);
+    CHECK(block_holds(buffer, 0));
+
+    uboot_blk_cache_shutdown();
+}
+
+static void test_select_hwpart(void)
+{
+    const struct blk_ops *ops;
+
+    fake_setup(FAKE_BLOCK_SIZE);
+    ops = fake_driver.ops;
+
+    fake_transfers_for_read(0, 10);
+    fake_transfers_for_read(1, 10);
+
+    // Selecting the current partition, as drivers do before each transfer,
+    // keeps the device's blocks.
+    CHECK_EQ(ops->select_hwpart(&fake_devices[0].dev, 0), 0);
+    CHECK_EQ(fake_transfers_for_read(0, 10), 0);
+
+    // Switching partition discards them, leaving other devices' blocks.
+    CHECK_EQ(ops->select_hwpart(&fake_devices[0].dev, 1), 0);
+    CHECK_EQ(fake_devices[0].desc.hwpart, 1);
+    CHECK_EQ(fake_transfers_for_read(0, 10), 1);
+    CHECK_EQ(fake_transfers_for_read(1, 10), 0);
+
+    uboot_blk_cache_shutdown();
+}
+
+int main(void)
+{
+    test_interpose();
+    test_hits_and_misses();
+    test_lru_replacement();
+    test_write_through();
+    test_select_hwpart();
+
+    return host_test_result("test_blk_cache");
+}
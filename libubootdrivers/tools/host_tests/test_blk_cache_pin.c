@@ -0,0 +1,108 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host test of the pinned range of the block cache (uboot_blk_cache.c), as
+ * used to hold the start of a FAT allocation table: memory being taken only
+ * once a range is pinned, pinned blocks never being replaced, replacing the
+ * pinned range, and writing back pinned blocks with the others. */
+
+#include "uboot_blk_cache.c"
+#include "host_test.h"
+#include "fake_blk_device.h"
+
+static struct uboot_blk_cache_stats get_stats(void)
+{
+    struct uboot_blk_cache_stats stats;
+
+    CHECK_EQ(uboot_blk_cache_get_stats(&stats), 0);
+    return stats;
+}
+
+static void test_pinned_blocks(void)
+{
+    fake_setup(FAKE_BLOCK_SIZE);
+    CHECK_EQ(get_stats().blocks_pinned_max, 4);
+
+    // No memory is taken for pinned blocks until a range is pinned, which
+    // is limited to the blocks configured.
+    CHECK(pin_data == NULL);
+    CHECK_EQ(uboot_blk_cache_pin(&fake_devices[0].dev, 100, 10), 0);
+    CHECK(pin_data != NULL);
+    CHECK_EQ(pin_count, 4);
+
+    for (int block = 100; block < 105; block++)
+        fake_transfers_for_read(0, block);
+    CHECK_EQ(get_stats().blocks_pinned, 4);
+    CHECK_EQ(get_stats().blocks_cached, 1);
+
+    // Reading more blocks than the cache holds replaces block 104, but not
+    // the pinned blocks.
+    for (int block = 0; block < 32; block++)
+        fake_transfers_for_read(0, block);
+    for (int block = 100; block < 104; block++)
+        CHECK_EQ(fake_transfers_for_read(0, block), 0);
+    CHECK_EQ(fake_transfers_for_read(0, 104), 1);
+
+    // Pinning the same range again keeps the blocks held.
+    CHECK_EQ(uboot_blk_cache_pin(&fake_devices[0].dev, 100, 4), 0);
+    CHECK_EQ(fake_transfers_for_read(0, 100), 0);
+
+    // Pinning another range releases them. Blocks of the new range already
+    // held are pinned as they are next read.
+    fake_transfers_for_read(0, 200);
+    CHECK_EQ(uboot_blk_cache_pin(&fake_devices[0].dev, 200, 2), 0);
+    CHECK_EQ(get_stats().blocks_pinned, 0);
+    CHECK_EQ(fake_transfers_for_read(0, 100), 1);
+    CHECK_EQ(fake_transfers_for_read(0, 200), 1);
+    CHECK_EQ(get_stats().blocks_pinned, 1);
+
+    // Purging forgets the pinned range.
+    uboot_blk_cache_purge();
+    fake_transfers_for_read(0, 200);
+    CHECK_EQ(get_stats().blocks_pinned, 0);
+    CHECK_EQ(fake_transfers_for_read(0, 200), 0);
+
+    uboot_blk_cache_shutdown();
+    CHECK(pin_data == NULL);
+}
+
+static void test_pinned_write_back(void)
+{
+    char buffer[3 * FAKE_BLOCK_SIZE];
+
+    fake_setup(FAKE_BLOCK_SIZE);
+
+    // Pinned blocks are held dirty like others, and written back merged
+    // with adjacent blocks that are not pinned.
+    CHECK_EQ(uboot_blk_cache_pin(&fake_devices[0].dev, 10, 2), 0);
+    memset(buffer, 0xee, sizeof(buffer));
+    CHECK_EQ(fake_cached_write(0, 9, 3, buffer), 3);
+    CHECK_EQ(fake_transfer_count, 0);
+    CHECK_EQ(get_stats().blocks_pinned, 2);
+    CHECK_EQ(get_stats().blocks_dirty, 3);
+
+    CHECK_EQ(uboot_blk_cache_flush(NULL), 0);
+    CHECK_EQ(fake_transfer_count, 1);
+    CHECK(fake_transfer_is(0, 'w', 9, 3));
+    CHECK_EQ(fake_devices[0].data[11 * FAKE_BLOCK_SIZE], (char)0xee);
+
+    // Pinning another range writes back the blocks it releases first.
+    CHECK_EQ(fake_cached_write(0, 10, 1, buffer), 1);
+    fake_transfer_count = 0;
+    CHECK_EQ(uboot_blk_cache_pin(&fake_devices[1].dev, 10, 2), 0);
+    CHECK(fake_transfer_is(0, 'w', 10, 1) && fake_transfers[0].dev == &fake_devices[0].dev);
+    CHECK_EQ(get_stats().blocks_dirty, 0);
+
+    uboot_blk_cache_shutdown();
+}
+
+int main(void)
+{
+    test_pinned_blocks();
+    test_pinned_write_back();
+
+    return host_test_result("test_blk_cache_pin");
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host test of readahead in the block cache (uboot_blk_cache.c): detection
+ * of sequential reads, the readahead window growing as it is consumed, the
+ * tracking of several streams at once, and readahead stopping at cached
+ * blocks and at the end of the device. */
+
+#include "uboot_blk_cache.c"
+#include "host_test.h"
+#include "fake_blk_device.h"
+
+static void test_window(void)
+{
+    struct uboot_blk_cache_stats stats;
+
+    fake_setup(FAKE_BLOCK_SIZE);
+
+    // A single read is not read ahead of.
+    CHECK_EQ(fake_transfers_for_read(0, 0), 1);
+
+    // Continuing it reads ahead by the initial window...
+    fake_transfer_count = 0;
+    CHECK_EQ(fake_transfers_for_read(0, 1), 2);
+    CHECK(fake_transfer_is(1, 'r', 2, 8));
+
+    // ...and consuming the window reads ahead by twice as many blocks.
+    fake_transfer_count = 0;
+    for (int block = 2; block < 10; block++)
+        fake_transfers_for_read(0, block);
+    CHECK_EQ(fake_transfer_count, 1);
+    CHECK(fake_transfer_is(0, 'r', 10, 16));
+
+    CHECK_EQ(uboot_blk_cache_get_stats(&stats), 0);
+    CHECK_EQ(stats.readahead, 24);
+    CHECK_EQ(stats.misses, 2);
+    CHECK_EQ(stats.hits, 8);
+
+    // Reads too large to be cached are not read ahead of.
+    char buffer[20 * FAKE_BLOCK_SIZE];
+    fake_transfer_count = 0;
+    fake_cached_read(0, 200, 20, buffer);
+    fake_cached_read(0, 220, 20, buffer);
+    CHECK_EQ(fake_transfer_count, 2);
+
+    uboot_blk_cache_shutdown();
+}
+
+static void test_streams(void)
+{
+    fake_setup(FAKE_BLOCK_SIZE);
+
+    // Interleaved sequential reads are each followed.
+    fake_transfers_for_read(0, 0);
+    fake_transfers_for_read(0, 500);
+    fake_transfers_for_read(1, 0);
+    fake_transfer_count = 0;
+    CHECK_EQ(fake_transfers_for_read(0, 1), 2);
+    CHECK_EQ(fake_transfers_for_read(0, 501), 2);
+    CHECK_EQ(fake_transfers_for_read(1, 1), 2);
+    CHECK(fake_transfer_is(1, 'r', 2, 8) && fake_transfers[1].dev == &fake_devices[0].dev);
+    CHECK(fake_transfer_is(3, 'r', 502, 8));
+    CHECK(fake_transfer_is(5, 'r', 2, 8) && fake_transfers[5].dev == &fake_devices[1].dev);
+
+    // Readahead stops at the first block already cached...
+    fake_transfers_for_read(0, 305);
+    fake_transfers_for_read(0, 300);
+    fake_transfer_count = 0;
+    CHECK_EQ(fake_transfers_for_read(0, 301), 2);
+    CHECK(fake_transfer_is(1, 'r', 302, 3));
+
+    // ...and at the end of the device.
+    fake_transfers_for_read(0, FAKE_BLOCKS - 4);
+    fake_transfer_count = 0;
+    CHECK_EQ(fake_transfers_for_read(0, FAKE_BLOCKS - 3), 2);
+    CHECK(fake_transfer_is(1, 'r', FAKE_BLOCKS - 2, 2));
+    CHECK_EQ(fake_transfers_for_read(0, FAKE_BLOCKS - 2), 0);
+    CHECK_EQ(fake_transfers_for_read(0, FAKE_BLOCKS - 1), 0);
+
+    uboot_blk_cache_shutdown();
+}
+
+int main(void)
+{
+    test_window();
+    test_streams();
+
+    return host_test_result("test_blk_cache_readahead");
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host test of the write-back block cache (uboot_blk_cache.c): holding
+ * written blocks until synced, writing them in block address order with
+ * adjacent blocks merged, the dirty block and time limits on holding them,
+ * keeping blocks that failed to write, and writing them back before a
+ * switch of hardware partition and on shutdown. */
+
+#include "uboot_blk_cache.c"
+#include "host_test.h"
+#include "fake_blk_device.h"
+
+static void write_block(int device, lbaint_t block, char value)
+{
+    char buffer[FAKE_BLOCK_SIZE];
+
+    memset(buffer, value, sizeof(buffer));
+    CHECK_EQ(fake_cached_write(device, block, 1, buffer), 1);
+}
+
+static unsigned long blocks_dirty(void)
+{
+    struct uboot_blk_cache_stats stats;
+
+    CHECK_EQ(uboot_blk_cache_get_stats(&stats), 0);
+    return stats.blocks_dirty;
+}
+
+static void test_held_until_synced(void)
+{
+    char buffer[FAKE_BLOCK_SIZE];
+
+    fake_setup(FAKE_BLOCK_SIZE);
+
+    // Written blocks are held, and read back from the cache.
+    write_block(0, 5, 0xaa);
+    CHECK_EQ(fake_transfer_count, 0);
+    CHECK_EQ(blocks_dirty(), 1);
+    CHECK_EQ(fake_devices[0].data[5 * FAKE_BLOCK_SIZE], 5);
+    CHECK_EQ(fake_cached_read(0, 5, 1, buffer), 1);
+    CHECK_EQ(fake_transfer_count, 0);
+    CHECK_EQ(buffer[0], (char)0xaa);
+
+    // They are written in block address order, adjacent blocks merged.
+    write_block(0, 12, 12);
+    write_block(0, 10, 10);
+    write_block(0, 11, 11);
+    write_block(0, 3, 3);
+    CHECK_EQ(uboot_blk_cache_flush(NULL), 0);
+    CHECK_EQ(fake_transfer_count, 3);
+    CHECK(fake_transfer_is(0, 'w', 3, 1));
+    CHECK(fake_transfer_is(1, 'w', 5, 1));
+    CHECK(fake_transfer_is(2, 'w', 10, 3));
+    CHECK_EQ(fake_devices[0].data[5 * FAKE_BLOCK_SIZE], (char)0xaa);
+    CHECK_EQ(fake_devices[0].data[11 * FAKE_BLOCK_SIZE], 11);
+    CHECK_EQ(blocks_dirty(), 0);
+
+    // Nothing remains to be written.
+    CHECK_EQ(uboot_blk_cache_flush(NULL), 0);
+    CHECK_EQ(fake_transfer_count, 3);
+
+    // Writes too large to be cached are written at once.
+    char large[5 * FAKE_BLOCK_SIZE];
+    memset(large, 0xcc, sizeof(large));
+    fake_transfer_count = 0;
+    CHECK_EQ(fake_cached_write(0, 100, 5, large), 5);
+    CHECK(fake_transfer_is(0, 'w', 100, 5));
+
+    uboot_blk_cache_shutdown();
+}
+
+static void test_flush_limits(void)
+{
+    fake_setup(FAKE_BLOCK_SIZE);
+
+    // Reaching the dirty block limit writes all dirty blocks.
+    for (int block = 20; block < 27; block++)
+        write_block(0, block, block);
+    CHECK_EQ(fake_transfer_count, 0);
+    write_block(0, 27, 27);
+    CHECK_EQ(fake_transfer_count, 1);
+    CHECK(fake_transfer_is(0, 'w', 20, 8));
+    CHECK_EQ(blocks_dirty(), 0);
+
+    // So does holding a block for the flush interval, checked on the next
+    // access.
+    fake_transfer_count = 0;
+    write_block(0, 30, 30);
+    fake_time_us += UBOOT_BLK_CACHE_FLUSH_MS * 1000 - 1;
+    CHECK_EQ(fake_transfers_for_read(0, 30), 0);
+    fake_time_us += 1;
+    CHECK_EQ(fake_transfers_for_read(0, 30), 1);
+    CHECK(fake_transfer_is(0, 'w', 30, 1));
+
+    uboot_blk_cache_shutdown();
+}
+
+static void test_failed_write_back(void)
+{
+    fake_setup(FAKE_BLOCK_SIZE);
+
+    // Blocks that fail to write remain dirty, to be written by a later sync.
+    write_block(0, 50, 0x50);
+    fake_failing_block = 50;
+    CHECK_EQ(uboot_blk_cache_flush(NULL), -EIO);
+    CHECK_EQ(blocks_dirty(), 1);
+
+    fake_failing_block = (lbaint_t)-1;
+    fake_transfer_count = 0;
+    CHECK_EQ(uboot_blk_cache_flush(NULL), 0);
+    CHECK(fake_transfer_is(0, 'w', 50, 1));
+    CHECK_EQ(blocks_dirty(), 0);
+
+    uboot_blk_cache_shutdown();
+}
+
+static void test_device_flushes(void)
+{
+    const struct blk_ops *ops;
+
+    fake_setup(FAKE_BLOCK_SIZE);
+    ops = fake_driver.ops;
+
+    // Syncing a device writes only its own blocks.
+    write_block(0, 60, 0x60);
+    write_block(1, 60, 0x61);
+    CHECK_EQ(uboot_blk_cache_flush(&fake_devices[1].dev), 0);
+    CHECK_EQ(fake_transfer_count, 1);
+    CHECK(fake_transfer_is(0, 'w', 60, 1) && fake_transfers[0].dev == &fake_devices[1].dev);
+    CHECK_EQ(blocks_dirty(), 1);
+
+    // A switch of hardware partition writes the device's blocks to the
+    // partition they were written to before switching.
+    fake_transfer_count = 0;
+    CHECK_EQ(ops->select_hwpart(&fake_devices[0].dev, 1), 0);
+    CHECK(fake_transfer_is(0, 'w', 60, 1) && fake_transfers[0].dev == &fake_devices[0].dev);
+    CHECK_EQ(blocks_dirty(), 0);
+
+    // Shutting down writes any blocks still held.
+    write_block(0, 70, 0x70);
+    fake_transfer_count = 0;
+    uboot_blk_cache_shutdown();
+    CHECK(fake_transfer_is(0, 'w', 70, 1));
+    CHECK_EQ(fake_devices[0].data[70 * FAKE_BLOCK_SIZE], 0x70);
+}
+
+int main(void)
+{
+    test_held_until_synced();
+    test_flush_limits();
+    test_failed_write_back();
+    test_device_flushes();
+
+    return host_test_result("test_blk_cache_write_back");
+}
@@ -0,0 +1,327 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host test of the queued block requests (uboot_blk.c): sorting of queued
+ * requests by block address, merging of adjacent requests into a single
+ * transfer (in place or through the merge buffer), completion reporting,
+ * the queue depth and the scoping of handles to their context. The block
+ * device is held in memory and records each transfer made. */
+
+#include "uboot_blk.c"
+#include "host_test.h"
+
+#define DEVICE_BLOCKS 1024
+#define BLOCK_SIZE 512
+#define MAX_TRANSFERS 64
+
+struct transfer_t {
+    bool write;
+    lbaint_t start;
+    lbaint_t blkcnt;
+    const void *buffer;
+};
+
+static char device_data[DEVICE_BLOCKS * BLOCK_SIZE];
+static struct blk_desc device = {
+    .type = DEV_TYPE_HARDDISK,
+    .blksz = BLOCK_SIZE,
+    .lba = DEVICE_BLOCKS,
+};
+
+// Transfers made to the device, and a block at which transfers fail.
+static struct transfer_t transfers[MAX_TRANSFERS];
+static int transfer_count;
+static lbaint_t failing_block = (lbaint_t)-1;
+
+// The selected context, MMC probes requested and the last channel notified.
+static struct uboot_ctx *selected_ctx = (struct uboot_ctx *)1;
+static int ensure_mmc_calls;
+static int notified_channel = -1;
+
+static unsigned long transfer(bool write, lbaint_t start, lbaint_t blkcnt,
+    const void *buffer)
+{
+    if (transfer_count < MAX_TRANSFERS)
+        transfers[transfer_count++] = (struct transfer_t){ write, start, blkcnt, buffer };
+
+    if (failing_block >= start && failing_block - start < blkcnt)
+        return failing_block - start;
+
+    if (write)
+        memcpy(device_data + start * BLOCK_SIZE, buffer, blkcnt * BLOCK_SIZE);
+    else
+        memcpy((void *)buffer, device_data + start * BLOCK_SIZE, blkcnt * BLOCK_SIZE);
+
+    return blkcnt;
+}
+
+unsigned long blk_dread(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+    void *buffer)
+{
+    return transfer(false, start, blkcnt, buffer);
+}
+
+unsigned long blk_dwrite(struct blk_desc *desc, lbaint_t start, lbaint_t blkcnt,
+    const void *buffer)
+{
+    return transfer(true, start, blkcnt, buffer);
+}
+
+struct blk_desc *blk_get_devnum_by_typename(const char *if_typename, int devnum)
+{
+    return (!strcmp(if_typename, "mmc") && devnum == 0) ? &device : NULL;
+}
+
+bool uboot_wrapper_is_initialised(void) { return true; }
+struct uboot_ctx *uboot_wrapper_get_ctx(void) { return selected_ctx; }
+int uboot_wrapper_ensure_mmc(void) { ensure_mmc_calls++; return 0; }
+int uboot_blk_cache_flush(struct udevice *dev) { return 0; }
+void microkit_notify(microkit_channel ch) { notified_channel = ch; }
+
+static struct uboot_blk_request request(bool write, unsigned long lba,
+    unsigned long count, void *buffer, uintptr_t cookie)
+{
+    return (struct uboot_blk_request){
+        .write = write,
+        .lba = lba,
+        .count = count,
+        .buffer = buffer,
+        .cookie = (void *)cookie,
+    };
+}
+
+static bool transfer_is(int index, bool write, lbaint_t start, lbaint_t blkcnt)
+{
+    return index < transfer_count && transfers[index].write == write &&
+        transfers[index].start == start && transfers[index].blkcnt == blkcnt;
+}
+
+static void reset_transfers(void)
+{
+    transfer_count = 0;
+}
+
+static void test_open(void)
+{
+    int handle = uboot_blk_open("usb", 0);
+    CHECK_EQ(handle, -ENODEV);
+    CHECK_EQ(ensure_mmc_calls, 0);
+
+    handle = uboot_blk_open("mmc", 0);
+    CHECK(handle >= 0);
+    CHECK_EQ(ensure_mmc_calls, 1);
+    uboot_blk_close(handle);
+}
+
+static void test_merge(int handle)
+{
+    static char buffer[8 * BLOCK_SIZE];
+    // Two blocks that do not follow on from each other in memory.
+    static char staged[3 * BLOCK_SIZE];
+    char *first = staged + 2 * BLOCK_SIZE, *second = staged;
+    struct uboot_blk_request req;
+
+    // Adjacent requests with adjacent buffers are transferred in place.
+    reset_transfers();
+    req = request(false, 12, 2, buffer + 2 * BLOCK_SIZE, 2);
+    uboot_blk_submit(handle, &req);
+    req = request(false, 10, 2, buffer, 1);
+    uboot_blk_submit(handle, &req);
+    CHECK_EQ(uboot_blk_process(handle), 2);
+    CHECK_EQ(transfer_count, 1);
+    CHECK(transfer_is(0, false, 10, 4) && transfers[0].buffer == buffer);
+
+    // Adjacent requests with separate buffers are staged through the merge
+    // buffer.
+    reset_transfers();
+    memset(first, 'a', BLOCK_SIZE);
+    memset(second, 'b', BLOCK_SIZE);
+    req = request(true, 20, 1, first, 3);
+    uboot_blk_submit(handle, &req);
+    req = request(true, 21, 1, second, 4);
+    uboot_blk_submit(handle, &req);
+    CHECK_EQ(uboot_blk_process(handle), 2);
+    CHECK_EQ(transfer_count, 1);
+    CHECK(transfer_is(0, true, 20, 2) && transfers[0].buffer == merge_buffer);
+    CHECK(device_data[20 * BLOCK_SIZE] == 'a' && device_data[22 * BLOCK_SIZE - 1] == 'b');
+
+    reset_transfers();
+    memset(first, 0, BLOCK_SIZE);
+    memset(second, 0, BLOCK_SIZE);
+    req = request(false, 21, 1, second, 5);
+    uboot_blk_submit(handle, &req);
+    req = request(false, 20, 1, first, 6);
+    uboot_blk_submit(handle, &req);
+    CHECK_EQ(uboot_blk_process(handle), 2);
+    CHECK_EQ(transfer_count, 1);
+    CHECK(first[0] == 'a' && second[BLOCK_SIZE - 1] == 'b');
+
+    // Requests in different directions, or beyond the size of the merge
+    // buffer, are not merged.
+    reset_transfers();
+    req = request(false, 30, 1, buffer, 7);
+    uboot_blk_submit(handle, &req);
+    req = request(true, 31, 1, buffer + BLOCK_SIZE, 8);
+    uboot_blk_submit(handle, &req);
+    uboot_blk_process(handle);
+    CHECK_EQ(transfer_count, 2);
+
+    reset_transfers();
+    unsigned long max_blocks = BLK_QUEUE_MERGE_BYTES / BLOCK_SIZE;
+    req = request(false, 100, max_blocks - 1, malloc(BLK_QUEUE_MERGE_BYTES), 9);
+    uboot_blk_submit(handle, &req);
+    void *first_buffer = req.buffer;
+    req = request(false, 100 + max_blocks - 1, 2, malloc(2 * BLOCK_SIZE), 10);
+    uboot_blk_submit(handle, &req);
+    uboot_blk_process(handle);
+    CHECK_EQ(transfer_count, 2);
+    free(first_buffer);
+    free(req.buffer);
+
+    struct uboot_blk_completion completions[MAX_BLK_QUEUE_DEPTH];
+    CHECK_EQ(uboot_blk_complete(handle, completions, MAX_BLK_QUEUE_DEPTH), 10);
+}
+
+static void test_order(int handle)
+{
+    static char buffer[4 * BLOCK_SIZE];
+    struct uboot_blk_request req;
+    struct uboot_blk_completion completions[MAX_BLK_QUEUE_DEPTH];
+
+    // Requests are issued, and complete, in block address order.
+    reset_transfers();
+    req = request(false, 300, 1, buffer, 3);
+    uboot_blk_submit(handle, &req);
+    req = request(false, 100, 1, buffer + BLOCK_SIZE, 1);
+    uboot_blk_submit(handle, &req);
+    req = request(true, 200, 1, buffer + 2 * BLOCK_SIZE, 2);
+    uboot_blk_submit(handle, &req);
+    CHECK_EQ(uboot_blk_process(handle), 3);
+    CHECK(transfer_is(0, false, 100, 1));
+    CHECK(transfer_is(1, true, 200, 1));
+    CHECK(transfer_is(2, false, 300, 1));
+    CHECK_EQ(uboot_blk_complete(handle, completions, MAX_BLK_QUEUE_DEPTH), 3);
+    for (int i = 0; i < 3; i++)
+        CHECK(completions[i].cookie == (void *)(uintptr_t)(i + 1) && completions[i].status == 0);
+
+    // A write overlapping another request keeps the submission order.
+    reset_transfers();
+    req = request(true, 300, 2, buffer, 1);
+    uboot_blk_submit(handle, &req);
+    req = request(false, 100, 1, buffer + 2 * BLOCK_SIZE, 2);
+    uboot_blk_submit(handle, &req);
+    req = request(false, 301, 1, buffer + 3 * BLOCK_SIZE, 3);
+    uboot_blk_submit(handle, &req);
+    uboot_blk_process(handle);
+    CHECK(transfer_is(0, true, 300, 2));
+    CHECK(transfer_is(1, false, 100, 1));
+    CHECK(transfer_is(2, false, 301, 1));
+    uboot_blk_complete(handle, completions, MAX_BLK_QUEUE_DEPTH);
+}
+
+static int callback_status = 1;
+static int callback_handle;
+
+static void resubmit_callback(void *cookie, int status)
+{
+    static char buffer[BLOCK_SIZE];
+
+    callback_status = status;
+
+    // Requests submitted while the batch is issued wait for the next one.
+    struct uboot_blk_request req = request(false, 500, 1, buffer, 99);
+    CHECK_EQ(uboot_blk_submit(callback_handle, &req), 0);
+}
+
+static void test_completion(int handle)
+{
+    static char buffer[2 * BLOCK_SIZE];
+    struct uboot_blk_request req;
+    struct uboot_blk_completion completions[MAX_BLK_QUEUE_DEPTH];
+
+    // A failed transfer fails every request merged into it.
+    reset_transfers();
+    failing_block = 401;
+    req = request(false, 400, 1, buffer, 1);
+    req.callback = resubmit_callback;
+    callback_handle = handle;
+    uboot_blk_submit(handle, &req);
+    req = request(false, 401, 1, buffer + BLOCK_SIZE, 2);
+    uboot_blk_submit(handle, &req);
+    uboot_blk_set_notify(handle, 7);
+    CHECK_EQ(uboot_blk_process(handle), 2);
+    failing_block = (lbaint_t)-1;
+    CHECK_EQ(callback_status, -EIO);
+    CHECK_EQ(notified_channel, 7);
+
+    // Completions are collected in order, a few at a time if requested.
+    CHECK_EQ(uboot_blk_complete(handle, completions, 1), 1);
+    CHECK(completions[0].cookie == (void *)1 && completions[0].status == -EIO);
+    CHECK_EQ(uboot_blk_complete(handle, completions, MAX_BLK_QUEUE_DEPTH), 1);
+    CHECK(completions[0].cookie == (void *)2 && completions[0].status == -EIO);
+
+    // The request submitted by the callback is issued by the next batch.
+    reset_transfers();
+    CHECK_EQ(uboot_blk_process(handle), 1);
+    CHECK(transfer_is(0, false, 500, 1));
+    CHECK_EQ(uboot_blk_complete(handle, completions, MAX_BLK_QUEUE_DEPTH), 1);
+    CHECK(completions[0].cookie == (void *)99);
+
+    // Requests are refused while the queue, including uncollected
+    // completions, is full.
+    req = request(false, 600, 1, buffer, 0);
+    for (int i = 0; i < MAX_BLK_QUEUE_DEPTH; i++)
+        CHECK_EQ(uboot_blk_submit(handle, &req), 0);
+    CHECK_EQ(uboot_blk_submit(handle, &req), -EAGAIN);
+    uboot_blk_process(handle);
+    CHECK_EQ(uboot_blk_submit(handle, &req), -EAGAIN);
+    CHECK_EQ(uboot_blk_complete(handle, completions, 1), 1);
+    CHECK_EQ(uboot_blk_submit(handle, &req), 0);
+    uboot_blk_process(handle);
+    CHECK_EQ(uboot_blk_complete(handle, completions, MAX_BLK_QUEUE_DEPTH), MAX_BLK_QUEUE_DEPTH);
+}
+
+static void test_contexts(void)
+{
+    static char buffer[BLOCK_SIZE];
+    struct uboot_ctx *first = (struct uboot_ctx *)1, *second = (struct uboot_ctx *)2;
+
+    selected_ctx = first;
+    int handle = uboot_blk_open("mmc", 0);
+    struct uboot_blk_request req = request(false, 700, 1, buffer, 1);
+    uboot_blk_submit(handle, &req);
+
+    // The handle cannot be used while another context is selected, nor
+    // closed by shutting down that context.
+    selected_ctx = second;
+    CHECK_EQ(uboot_blk_read(handle, 0, 1, buffer), -EBADF);
+    CHECK_EQ(uboot_blk_submit(handle, &req), -EBADF);
+    uboot_blk_close_all(second);
+    selected_ctx = first;
+    CHECK(blk_handles[handle] != NULL);
+
+    // Shutting down its own context completes its requests and closes it.
+    reset_transfers();
+    uboot_blk_close_all(first);
+    CHECK(transfer_is(0, false, 700, 1));
+    CHECK(blk_handles[handle] == NULL);
+    CHECK_EQ(uboot_blk_read(handle, 0, 1, buffer), -EBADF);
+}
+
+int main(void)
+{
+    test_open();
+
+    int handle = uboot_blk_open("mmc", 0);
+    test_merge(handle);
+    test_order(handle);
+    test_completion(handle);
+    uboot_blk_close(handle);
+
+    test_contexts();
+
+    return host_test_result("test_blk_queue");
+}
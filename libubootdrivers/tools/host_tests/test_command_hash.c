@@ -0,0 +1,63 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host test of the perfect hash of command names generated by
+ * gen_driver_lists.py, looked up through uboot_command_find
+ * (uboot_command.c). Built once for each platform, with the index generated
+ * from the platform's plat_driver_data.h. Every command must be found
+ * through its own slot of the table, without U-Boot's search. */
+
+#include "uboot_command.c"
+#include "host_test.h"
+
+// The platform's command names, NULL terminated, generated with an entry
+// for each.
+extern const char *const test_command_names[];
+
+// Calls made to U-Boot's search of the command table.
+static int find_cmd_calls;
+
+struct cmd_tbl *find_cmd(const char *cmd)
+{
+    find_cmd_calls++;
+    return NULL;
+}
+
+int cmd_usage(const struct cmd_tbl *cmdtp) { return 1; }
+bool uboot_wrapper_is_initialised(void) { return true; }
+int uboot_wrapper_ensure_for_command(const char *cmd) { return 0; }
+
+int main(void)
+{
+    unsigned int count = 0;
+
+    for (const char *const *name = test_command_names; *name != NULL; name++) {
+        struct cmd_tbl *cmdtp = uboot_command_find(*name);
+        CHECK(cmdtp != NULL && !strcmp(cmdtp->name, *name));
+        count++;
+    }
+    CHECK(count > 0);
+    CHECK_EQ(find_cmd_calls, 0);
+
+    // Each command has a slot of its own, in a table of a power of two
+    // slots at least twice the number of commands.
+    unsigned int used = 0;
+    for (unsigned int slot = 0; slot <= uboot_command_hash_mask; slot++)
+        if (uboot_command_hash_table[slot] != NULL)
+            used++;
+    CHECK_EQ(used, count);
+    CHECK_EQ(uboot_command_hash_mask & (uboot_command_hash_mask + 1), 0);
+    CHECK(uboot_command_hash_mask + 1 >= 2 * count);
+
+    // Names that are not commands, or are abbreviations or variants of
+    // commands, are passed to U-Boot's search.
+    CHECK(uboot_command_find("no_such_command") == NULL);
+    CHECK(uboot_command_find("") == NULL);
+    CHECK(uboot_command_find("mm") == NULL);
+    CHECK_EQ(find_cmd_calls, 3);
+
+    return host_test_result("test_command_hash");
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host test of the command statistics (uboot_command_stats.c): splitting of
+ * command strings into words, the histogram bucket of each time taken, and
+ * the counts kept for each command name. */
+
+#include <limits.h>
+#include "uboot_command_stats.c"
+#include "host_test.h"
+
+// Value of the 'filesize' environment variable seen by command_bytes.
+static unsigned long filesize;
+
+unsigned long env_get_hex(const char *varname, unsigned long default_val)
+{
+    return !strcmp(varname, "filesize") ? filesize : default_val;
+}
+
+static int bucket_of(unsigned long elapsed_us)
+{
+    struct command_stats_t *stats = find_command_stats("bucket");
+
+    memset(stats->buckets, 0, sizeof(stats->buckets));
+    uboot_command_stats_record("bucket", elapsed_us, 0);
+
+    for (int bucket = 0; bucket < STATS_BUCKETS; bucket++)
+        if (stats->buckets[bucket] != 0)
+            return bucket;
+
+    return -1;
+}
+
+static void test_get_word(void)
+{
+    char word[8];
+
+    CHECK(get_word("  fatls\tmmc 0:1", 0, word, sizeof(word)) && !strcmp(word, "fatls"));
+    CHECK(get_word("  fatls\tmmc 0:1", 1, word, sizeof(word)) && !strcmp(word, "mmc"));
+    CHECK(get_word("  fatls\tmmc 0:1", 2, word, sizeof(word)) && !strcmp(word, "0:1"));
+    CHECK(!get_word("  fatls\tmmc 0:1", 3, word, sizeof(word)));
+    CHECK(!get_word("   ", 0, word, sizeof(word)));
+
+    // Words end at a command separator, and the following commands are not
+    // part of the command.
+    CHECK(get_word("ping 1.2.3.4;dhcp", 1, word, sizeof(word)) && !strcmp(word, "1.2.3.4"));
+    CHECK(!get_word("ping;dhcp", 1, word, sizeof(word)));
+
+    // Long words are truncated to the size given.
+    CHECK(get_word("fatwrite_long", 0, word, sizeof(word)) && !strcmp(word, "fatwrit"));
+}
+
+static void test_buckets(void)
+{
+    CHECK_EQ(bucket_of(0), 0);
+    CHECK_EQ(bucket_of(1), 0);
+    CHECK_EQ(bucket_of(2), 1);
+    CHECK_EQ(bucket_of(3), 1);
+    CHECK_EQ(bucket_of(4), 2);
+    CHECK_EQ(bucket_of(1023), 9);
+    CHECK_EQ(bucket_of(1024), 10);
+    CHECK_EQ(bucket_of(1UL << 30), 30);
+    CHECK_EQ(bucket_of(ULONG_MAX), STATS_BUCKETS - 1);
+}
+
+static void test_counts(void)
+{
+    uboot_command_stats_record("fatload mmc 0:1 0x40000000 log.txt", 100, 0);
+    uboot_command_stats_record("fatload mmc 0:1 0x40000000 missing.txt", 300, 1);
+    filesize = 0x200;
+    uboot_command_stats_record("fatload mmc 0:1 0x40000000 log.txt", 200, 0);
+
+    struct command_stats_t *stats = find_command_stats("fatload");
+    CHECK_EQ(stats->count, 3);
+    CHECK_EQ(stats->failures, 1);
+    CHECK_EQ(stats->total_us, 600);
+    CHECK_EQ(stats->max_us, 300);
+    CHECK_EQ(stats->bytes, 0x200);
+
+    // Writes take the size written from their fifth argument, in hex.
+    uboot_command_stats_record("fatwrite mmc 0:1 0x40000000 log.txt 400", 50, 0);
+    uboot_command_stats_record("fatwrite mmc 0:1 0x40000000 log.txt", 50, 0);
+    CHECK_EQ(find_command_stats("fatwrite")->bytes, 0x400);
+    uboot_command_stats_record("save mmc 0:1 0x40000000 log.txt 10", 50, 0);
+    CHECK_EQ(find_command_stats("save")->bytes, 0x10);
+
+    // Other commands transfer no bytes.
+    uboot_command_stats_record("mmc info", 10, 0);
+    CHECK_EQ(find_command_stats("mmc")->bytes, 0);
+
+    // Empty commands are not recorded.
+    uboot_command_stats_record("  ", 10, 0);
+    CHECK(find_command_stats("") == NULL || find_command_stats("")->count == 0);
+}
+
+static void test_table_full(void)
+{
+    char name[MAX_STATS_NAME];
+
+    for (int i = 0; i < MAX_STATS_COMMANDS; i++) {
+        snprintf(name, sizeof(name), "cmd%d", i);
+        uboot_command_stats_record(name, 1, 0);
+    }
+
+    // Statistics are kept for the first commands seen only.
+    CHECK(find_command_stats("another") == NULL);
+    CHECK_EQ(find_command_stats("fatload")->count, 3);
+}
+
+int main(void)
+{
+    test_get_word();
+    test_buckets();
+    test_counts();
+    test_table_full();
+
+    return host_test_result("test_command_stats");
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright 2022, Capgemini Engineering
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* Host test of prepared commands and the direct dispatch of commands
+ * (uboot_command.c): splitting of commands and formats into arguments, the
+ * formatting of each argument type, the flag commands are called with and
+ * the rejection of commands needing the command line parser. */
+
+#include "uboot_command.c"
+#include "host_test.h"
+
+// An empty command index, so that commands are found through find_cmd.
+const unsigned int uboot_command_hash_seed = 0;
+const unsigned int uboot_command_hash_mask = 0;
+struct cmd_tbl *const uboot_command_hash_table[1];
+
+// The arguments and flag of the last command called, and the value the
+// command returns.
+static char last_argv[MAX_COMMAND_ARGS][MAX_COMMAND_LENGTH];
+static int last_argc;
+static int last_flag;
+static int command_ret;
+static int usage_calls;
+
+static int do_command(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
+{
+    last_argc = argc;
+    last_flag = flag;
+    for (int i = 0; i < argc && i < MAX_COMMAND_ARGS; i++)
+        snprintf(last_argv[i], sizeof(last_argv[i]), "%s", argv[i]);
+
+    return command_ret;
+}
+
+static struct cmd_tbl commands[] = {
+    { .name = "fatwrite", .maxargs = 7, .cmd = do_command },
+    { .name = "echo", .maxargs = CONFIG_SYS_MAXARGS, .cmd = do_command },
+    { .name = "reset", .maxargs = 1, .cmd = do_command },
+};
+
+struct cmd_tbl *find_cmd(const char *cmd)
+{
+    for (int i = 0; i < ARRAY_SIZE(commands); i++)
+        if (!strcmp(commands[i].name, cmd))
+            return &commands[i];
+
+    return NULL;
+}
+
+int cmd_usage(const struct cmd_tbl *cmdtp)
+{
+    usage_calls++;
+    return 1;
+}
+
+bool uboot_wrapper_is_initialised(void) { return true; }
+int uboot_wrapper_ensure_for_command(const char *cmd) { return 0; }
+
+static bool last_args_are(int argc, const char *const *argv)
+{
+    if (last_argc != argc)
+        return false;
+
+    for (int i = 0; i < argc; i++)
+        if (strcmp(last_argv[i], argv[i]))
+            return false;
+
+    return true;
+}
+
+static void test_exec(void)
+{
+    int handle = uboot_command_prepare("fatwrite mmc  0:1\t%lx %s %x");
+    CHECK(handle >= 0);
+
+    last_flag = 0;
+    CHECK_EQ(uboot_command_exec(handle, 0x40000000UL, "log.txt", 0x200U), 0);
+    const char *const fatwrite[] = { "fatwrite", "mmc", "0:1", "40000000", "log.txt", "200" };
+    CHECK(last_args_are(6, fatwrite));
+    CHECK_EQ(last_flag, CMD_FLAG_ENV);
+
+    // Each run formats its own arguments.
+    CHECK_EQ(uboot_command_exec(handle, 0x1UL, "other.txt", 0x10U), 0);
+    const char *const again[] = { "fatwrite", "mmc", "0:1", "1", "other.txt", "10" };
+    CHECK(last_args_are(6, again));
+    uboot_command_release(handle);
+
+    handle = uboot_command_prepare("echo %d %i %u %lu %p");
+    CHECK_EQ(uboot_command_exec(handle, -5, 7, 4000000000U, 123456789012UL, (void *)0x1000), 0);
+    const char *const echo[] = { "echo", "-5", "7", "4000000000", "123456789012", "1000" };
+    CHECK(last_args_are(6, echo));
+
+    // Failures are reported as 1, and misuse also prints the usage.
+    command_ret = CMD_RET_FAILURE;
+    CHECK_EQ(uboot_command_exec(handle, 0, 0, 0U, 0UL, NULL), 1);
+    command_ret = CMD_RET_USAGE;
+    CHECK_EQ(uboot_command_exec(handle, 0, 0, 0U, 0UL, NULL), 1);
+    CHECK_EQ(usage_calls, 1);
+    command_ret = CMD_RET_SUCCESS;
+
+    uboot_command_release(handle);
+    CHECK_EQ(uboot_command_exec(handle), -EBADF);
+    CHECK_EQ(uboot_command_exec(-1), -EBADF);
+    CHECK_EQ(uboot_command_exec(MAX_PREPARED_COMMANDS), -EBADF);
+}
+
+static void test_prepare_errors(void)
+{
+    // Commands needing the command line parser.
+    CHECK_EQ(uboot_command_prepare("echo $filesize"), -EINVAL);
+    CHECK_EQ(uboot_command_prepare("echo a; echo b"), -EINVAL);
+    CHECK_EQ(uboot_command_prepare("echo 'a b'"), -EINVAL);
+
+    // Unsupported formats.
+    CHECK_EQ(uboot_command_prepare("%s mmc"), -EINVAL);
+    CHECK_EQ(uboot_command_prepare("echo 0x%x"), -EINVAL);
+    CHECK_EQ(uboot_command_prepare("echo %f"), -EINVAL);
+
+    // Empty, unknown and misused commands.
+    CHECK_EQ(uboot_command_prepare("   "), -EINVAL);
+    CHECK_EQ(uboot_command_prepare("no_such_command"), -EINVAL);
+    CHECK_EQ(uboot_command_prepare("reset now"), -EINVAL);
+
+    // Handles run out once all are in use.
+    int handles[MAX_PREPARED_COMMANDS];
+    for (int i = 0; i < MAX_PREPARED_COMMANDS; i++)
+        handles[i] = uboot_command_prepare("reset");
+    CHECK(handles[MAX_PREPARED_COMMANDS - 1] >= 0);
+    CHECK_EQ(uboot_command_prepare("reset"), -ENFILE);
+    for (int i = 0; i < MAX_PREPARED_COMMANDS; i++)
+        uboot_command_release(handles[i]);
+}
+
+static void test_run_direct(void)
+{
+    last_flag = 0;
+    CHECK_EQ(uboot_command_run_direct("  fatwrite mmc\t0:1 40000000  log.txt 200 ", CMD_FLAG_ENV), 0);
+    const char *const fatwrite[] = { "fatwrite", "mmc", "0:1", "40000000", "log.txt", "200" };
+    CHECK(last_args_are(6, fatwrite));
+    CHECK_EQ(last_flag, CMD_FLAG_ENV);
+
+    command_ret = CMD_RET_FAILURE;
+    CHECK_EQ(uboot_command_run_direct("reset", 0), 1);
+    command_ret = CMD_RET_SUCCESS;
+
+    // Commands the parser must handle, or report, are left to it.
+    CHECK_EQ(uboot_command_run_direct("echo $filesize", 0), -EAGAIN);
+    CHECK_EQ(uboot_command_run_direct("echo a; echo b", 0), -EAGAIN);
+    CHECK_EQ(uboot_command_run_direct("", 0), -EAGAIN);
+    CHECK_EQ(uboot_command_run_direct("no_such_command", 0), -EAGAIN);
+    CHECK_EQ(uboot_command_run_direct("reset now", 0), -EAGAIN);
+
+    char long_command[CONFIG_SYS_CBSIZE + 1];
+    memset(long_command, 'a', sizeof(long_command) - 1);
+    long_command[sizeof(long_command) - 1] = '\0';
+    memcpy(long_command, "echo ", 5);
+    CHECK_EQ(uboot_command_run_direct(long_command, 0), -EAGAIN);
+}
+
+int main(void)
+{
+    test_exec();
+    test_prepare_errors();
+    test_run_direct();
+
+    return host_test_result("test_prepared_command");
+}
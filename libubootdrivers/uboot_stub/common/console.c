@@ -10,11 +10,190 @@
 /* This is a minimal stub of U-Boot's console package providing the subset
  * of functionality required to allow basic input / output devices to be
  * registered and accessed by the driver library.
+ *
+ * It also provides a hashed registry of the stdio devices by name. Calls to
+ * stdio_get_by_name are directed here (through the linker's --wrap option)
+ * rather than searching the device list, and the registry is rebuilt from
+ * the device list after any device is registered or deregistered.
+ *
+ * The global data of the library context selected when each device is
+ * registered is recorded as its owner, so that the devices registered by a
+ * context's drivers can be removed when the context is shut down.
  */
 
 #include <common.h>
 #include <stdio_dev.h>
 #include <env.h>
+#include <linux/list.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Number of slots in the registry; a power of two, at least twice the
+ * number of devices held */
+#define STDIO_REGISTRY_SLOTS	16
+
+static struct stdio_dev *stdio_registry[STDIO_REGISTRY_SLOTS];
+static bool stdio_registry_valid;
+
+/* Number of devices whose owner is recorded */
+#define STDIO_OWNER_SLOTS	16
+
+static struct {
+	struct stdio_dev *dev;
+	const gd_t *owner;
+} stdio_owners[STDIO_OWNER_SLOTS];
+
+struct stdio_dev *__real_stdio_get_by_name(const char *name);
+int __real_stdio_init(void);
+int __real_stdio_register(struct stdio_dev *dev);
+int __real_stdio_register_dev(struct stdio_dev *dev, struct stdio_dev **devp);
+int __real_stdio_deregister(const char *devname, int force);
+int __real_stdio_deregister_dev(struct stdio_dev *dev, int force);
+
+/* FNV-1a hash of a device name */
+static unsigned int stdio_hash_name(const char *name)
+{
+	unsigned int hash = 2166136261U;
+
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619U;
+	}
+
+	return hash ^ (hash >> 16);
+}
+
+static struct stdio_dev **stdio_registry_slot(const char *name)
+{
+	unsigned int slot = stdio_hash_name(name) & (STDIO_REGISTRY_SLOTS - 1);
+
+	while (stdio_registry[slot] && strcmp(stdio_registry[slot]->name, name))
+		slot = (slot + 1) & (STDIO_REGISTRY_SLOTS - 1);
+
+	return &stdio_registry[slot];
+}
+
+static bool stdio_registry_build(void)
+{
+	struct list_head *pos;
+	int count = 0;
+
+	memset(stdio_registry, 0, sizeof(stdio_registry));
+
+	list_for_each(pos, stdio_get_list()) {
+		struct stdio_dev *dev = list_entry(pos, struct stdio_dev, list);
+		struct stdio_dev **slot;
+
+		if (++count > STDIO_REGISTRY_SLOTS / 2)
+			return false;
+
+		/* As with the list search, the first device of a name is found */
+		slot = stdio_registry_slot(dev->name);
+		if (!*slot)
+			*slot = dev;
+	}
+
+	return true;
+}
+
+/* Record the selected context as the owner of the device just registered,
+ * which is added to the end of the device list */
+static void stdio_record_owner(void)
+{
+	struct list_head *list = stdio_get_list();
+	int i;
+
+	if (list_empty(list))
+		return;
+
+	for (i = 0; i < STDIO_OWNER_SLOTS; i++) {
+		if (!stdio_owners[i].dev) {
+			stdio_owners[i].dev = list_last_entry(list, struct stdio_dev, list);
+			stdio_owners[i].owner = gd;
+			return;
+		}
+	}
+
+	printf("stdio: Unable to record owner of device\n");
+}
+
+static void stdio_forget_owner(struct stdio_dev *dev)
+{
+	for (int i = 0; i < STDIO_OWNER_SLOTS; i++)
+		if (stdio_owners[i].dev == dev)
+			stdio_owners[i].dev = NULL;
+}
+
+struct stdio_dev *__wrap_stdio_get_by_name(const char *name)
+{
+	struct stdio_dev *dev;
+
+	if (!name)
+		return NULL;
+
+	if (!stdio_registry_valid)
+		stdio_registry_valid = stdio_registry_build();
+
+	if (stdio_registry_valid) {
+		dev = *stdio_registry_slot(name);
+		if (dev)
+			return dev;
+	}
+
+	/* Not registered (or too many devices to hold); U-Boot may create
+	 * the device on demand */
+	return __real_stdio_get_by_name(name);
+}
+
+int __wrap_stdio_init(void)
+{
+	int ret = __real_stdio_init();
+
+	memset(stdio_owners, 0, sizeof(stdio_owners));
+	stdio_registry_valid = false;
+	return ret;
+}
+
+int __wrap_stdio_register(struct stdio_dev *dev)
+{
+	int ret = __real_stdio_register(dev);
+
+	if (!ret)
+		stdio_record_owner();
+	stdio_registry_valid = false;
+	return ret;
+}
+
+int __wrap_stdio_register_dev(struct stdio_dev *dev, struct stdio_dev **devp)
+{
+	int ret = __real_stdio_register_dev(dev, devp);
+
+	if (!ret)
+		stdio_record_owner();
+	stdio_registry_valid = false;
+	return ret;
+}
+
+int __wrap_stdio_deregister(const char *devname, int force)
+{
+	struct stdio_dev *dev = __real_stdio_get_by_name(devname);
+	int ret = __real_stdio_deregister(devname, force);
+
+	if (!ret)
+		stdio_forget_owner(dev);
+	stdio_registry_valid = false;
+	return ret;
+}
+
+int __wrap_stdio_deregister_dev(struct stdio_dev *dev, int force)
+{
+	int ret = __real_stdio_deregister_dev(dev, force);
+
+	if (!ret)
+		stdio_forget_owner(dev);
+	stdio_registry_valid = false;
+	return ret;
+}
 
 static int console_setfile(int file, struct stdio_dev * dev)
 {
@@ -69,6 +248,27 @@ int console_assign(int file, const char *devname)
 	return -1;
 }
 
+void stdio_remove_owned(const gd_t *owner)
+{
+	for (int i = 0; i < STDIO_OWNER_SLOTS; i++) {
+		struct stdio_dev *dev = stdio_owners[i].dev;
+
+		if (!dev || stdio_owners[i].owner != owner)
+			continue;
+
+		list_del(&dev->list);
+		stdio_owners[i].dev = NULL;
+		stdio_registry_valid = false;
+
+		/* Files using the device revert to the null device */
+		for (int file = 0; file < MAX_FILES; file++)
+			if (stdio_devices[file] == dev && console_assign(file, "nulldev"))
+				stdio_devices[file] = NULL;
+
+		free(dev);
+	}
+}
+
 void stdio_print_current_devices(void)
 {
 	/* Print information */
@@ -9,20 +9,43 @@
 #define __LINKER_LISTS_H__
 
 /* This is a replacement version of the linker_lists header file provided
- * U-Boot. Instead of mapping on to entries in a special linker section we
- * instead just map on to entries in the driver_data instantiation of the
- * driver_data_t structure.
+ * U-Boot. As in U-Boot each entry is placed in its own section, but rather
+ * than gathering every entry linked, the sections are placed by a linker
+ * script fragment generated from the platform's plat_driver_data.h (see
+ * scripts/gen_driver_lists.py). Only the entries listed for the platform are
+ * placed, in the order listed, between the __u_boot_list_<list>_start and
+ * __u_boot_list_<list>_end symbols.
+ *
+ * Entries are given the natural alignment of their type so that the compiler
+ * does not pad the alignment of larger entries, leaving gaps in the list.
  */
 
 #define llsym(_type, _name, _list) 	((_type *)&_u_boot_##_list##__##_name)
 
-#define ll_entry_declare(_type, _name, _list)	_type _u_boot_##_list##__##_name
+#define ll_entry_declare(_type, _name, _list)									\
+	_type _u_boot_##_list##__##_name __attribute__((used,						\
+		aligned(__alignof__(_type)),											\
+		section(".u_boot_list_2_" #_list "_2_" #_name)))
 
-#define ll_entry_start(_type, _list)	(_type *)driver_data_start._list##_start
+#define ll_entry_start(_type, _list)												\
+	({																				\
+		extern _type __u_boot_list_##_list##_start[];								\
+		__u_boot_list_##_list##_start;												\
+	})
 
-#define ll_entry_end(_type, _list)	(_type *)driver_data_end._list##_start
+#define ll_entry_end(_type, _list)												\
+	({																				\
+		extern _type __u_boot_list_##_list##_end[];									\
+		__u_boot_list_##_list##_end;												\
+	})
 
-#define ll_entry_count(_type, _list)	_u_boot_##_list##_count
+#define ll_entry_count(_type, _list)												\
+	({																				\
+		_type *_ll_start = ll_entry_start(_type, _list);							\
+		_type *_ll_end = ll_entry_end(_type, _list);								\
+		unsigned int _ll_count = _ll_end - _ll_start;								\
+		_ll_count;																	\
+	})
 
 #define ll_entry_get(_type, _name, _list)											\
 	({																				\
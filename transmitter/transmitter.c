@@ -20,7 +20,8 @@
 #include <mmc_platform_devices.h>
 #include <circular_buffer.h>
 
-#define LOG_FILE_DEVICE "mmc 0:1"  // Partition 1 on mmc device 0
+#define LOG_FILE_INTERFACE "mmc"
+#define LOG_FILE_PARTITION "0:1"  // Partition 1 on mmc device 0
 #define LOG_FILENAME  "transmitter_log.txt"
 #define LOG_FILE_WRITE_PERIOD_US 30000000  // Time between log file writes (30 seconds)
 
@@ -39,43 +40,25 @@ uintptr_t dma_base;
 uintptr_t dma_cp_paddr;
 size_t dma_size = 0x100000;
 
+/* Handle of the open log file */
+static int log_file = -1;
+
 void write_pending_mmc_log()
 {
-    /* Track the total number of bytes written to the log file */
-    static uint total_bytes_written = 0;
-
     /* Write all keypresses stored in the 'mmc_pending_tx_buf' buffer to the log file */
-    char uboot_cmd[64];
-    sprintf(uboot_cmd, "fatwrite %s 0x%x %s %x %x",
-        LOG_FILE_DEVICE,        // The U-Boot partition designation
-        &mmc_pending_tx_buf,    // Address of the buffer to write
-        LOG_FILENAME,           // Filename to log to
-        mmc_pending_length,     // The number of bytes to write
-        total_bytes_written);   // The offset in the file to start writing from
-    int ret = run_uboot_command(uboot_cmd);
-
-    // Test string to read the file into
-    char read_string[mmc_pending_length];
-
-    // Read then output contents of the file
-    sprintf(uboot_cmd, "fatload %s 0x%x %s %x %x",
-        LOG_FILE_DEVICE,      // The U-Boot partition designation
-        &read_string,         // Address to read the data into
-        LOG_FILENAME,         // Filename to read from
-        mmc_pending_length,   // Max number of bytes to read (0 = to end of file)
-        total_bytes_written); // The offset in the file to start read from
-    run_uboot_command(uboot_cmd);
-    printf("String read from file %s: %s\n", LOG_FILENAME, read_string);
+    int ret = uboot_fs_append(log_file, mmc_pending_tx_buf, mmc_pending_length);
 
-    /* Clear the buffer if writing to the file was successful */
+    /* Clear the buffer once the file holds the characters. If the sync below
+     * fails they remain buffered by the file and are written by the next sync,
+     * so must not be appended again. */
     if (ret >= 0) {
-        total_bytes_written += mmc_pending_length;
-
         /* All pending characters have now been sent. Clear the buffer */
         memset(mmc_pending_tx_buf, 0, mmc_pending_length);
         mmc_pending_length = 0;
     }
 
+    uboot_fs_sync(log_file);
+
     printf("End of write_mmc_log\n");
 }
 
@@ -106,6 +89,14 @@ init_post(void)
     /* List the device tree paths for the devices */
     const_dev_paths, DEV_PATH_COUNT);
 
+    /* Open the log file on the first notification, keeping the partition
+     * resolved between writes */
+    if (log_file < 0) {
+        log_file = uboot_fs_open(LOG_FILE_INTERFACE, LOG_FILE_PARTITION, LOG_FILENAME);
+        if (log_file < 0) {
+            assert(!"Failed to open the log file");
+        }
+    }
 
     /* Now poll for events and handle them */
     bool idle_cycle;
@@ -163,7 +154,7 @@ init(void)
 
     /* Delete any existing log file to ensure we start with an empty file */
     char uboot_cmd[64];
-    sprintf(uboot_cmd, "fatrm %s %s", LOG_FILE_DEVICE, LOG_FILENAME);
+    sprintf(uboot_cmd, "fatrm %s %s %s", LOG_FILE_INTERFACE, LOG_FILE_PARTITION, LOG_FILENAME);
     run_uboot_command(uboot_cmd);
 }
 